@@ -0,0 +1,558 @@
+#include "hermes.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#if __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+const size_t kCacheLine = 64;
+
+HERMES_ALWAYS_INLINE inline void cpu_relax() {
+#if __x86_64__ || __amd64__ || _M_AMD64 || _M_IX86
+    _mm_pause();
+#elif __aarch64__
+    asm volatile ("yield" ::: "memory");
+#endif
+}
+
+// spins on a condition, yielding once the other side is clearly not
+// running, so that oversubscribed hosts still make progress
+template <class F>
+HERMES_ALWAYS_INLINE inline void spin_until(F &&cond) {
+    size_t spins = 0;
+    while (!cond()) {
+        cpu_relax();
+        if (++spins % 4096 == 0)
+            std::this_thread::yield();
+    }
+}
+
+// cpus this process may run on, captured before run_all pins the main thread
+std::vector<int64_t> allowed_cpus() {
+    std::vector<int64_t> cpus;
+#if __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof set, &set) == 0) {
+        for (int i = 0; i < CPU_SETSIZE; i++) {
+            if (CPU_ISSET(i, &set))
+                cpus.push_back(i);
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        unsigned n = std::max(std::thread::hardware_concurrency(), 1u);
+        for (unsigned i = 0; i < n; i++)
+            cpus.push_back(i);
+    }
+    return cpus;
+}
+
+std::vector<int64_t> const cpus = allowed_cpus();
+
+std::vector<int64_t> thread_range() {
+    std::vector<int64_t> counts;
+    for (int64_t n = 1; n < (int64_t)cpus.size(); n *= 2)
+        counts.push_back(n);
+    counts.push_back(std::max<int64_t>(cpus.size(), 1));
+    return counts;
+}
+
+int current_cpu() {
+#if __linux__
+    return sched_getcpu();
+#else
+    return 0;
+#endif
+}
+
+void pin_thread(int64_t cpu) {
+#if __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof set, &set);
+#else
+    (void)cpu;
+#endif
+}
+
+// moves the measuring thread onto another cpu for the lifetime of the
+// object, restoring the pinning done by run_all afterwards
+struct ScopedPin {
+#if __linux__
+    cpu_set_t saved;
+#endif
+
+    explicit ScopedPin(int64_t cpu) {
+#if __linux__
+        pthread_getaffinity_np(pthread_self(), sizeof saved, &saved);
+#endif
+        pin_thread(cpu);
+    }
+
+    ~ScopedPin() {
+#if __linux__
+        pthread_setaffinity_np(pthread_self(), sizeof saved, &saved);
+#endif
+    }
+};
+
+// the cpu for the i-th helper thread, skipping the measuring thread's own
+int64_t helper_cpu(size_t i, int64_t self) {
+    std::vector<int64_t> others;
+    for (int64_t c: cpus) {
+        if (c != self)
+            others.push_back(c);
+    }
+    if (others.empty())
+        return self;
+    return others[i % others.size()];
+}
+
+// runs n helper threads, each pinned to a cpu other than the measuring
+// thread's, until destruction; construction returns once all are running
+struct Helpers {
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> ready{0};
+    std::vector<std::thread> threads;
+
+    template <class F>
+    Helpers(size_t n, F f) {
+        int64_t self = current_cpu();
+        for (size_t i = 0; i < n; i++) {
+            threads.emplace_back([this, i, self, f] {
+                pin_thread(helper_cpu(i, self));
+                ready.fetch_add(1);
+                f(i, stop);
+            });
+        }
+        spin_until([&] { return ready.load() == n; });
+    }
+
+    Helpers(Helpers &&) = delete;
+
+    ~Helpers() {
+        stop.store(true);
+        for (auto &t: threads)
+            t.join();
+    }
+};
+
+struct alignas(kCacheLine) Spinlock {
+    std::atomic<bool> locked{false};
+
+    void lock() {
+        while (locked.exchange(true, std::memory_order_acquire))
+            spin_until([&] { return !locked.load(std::memory_order_relaxed); });
+    }
+
+    void unlock() {
+        locked.store(false, std::memory_order_release);
+    }
+};
+
+// single producer single consumer ring buffer, each side caches the
+// other side's index to avoid touching its cache line on every operation
+template <class T>
+struct SpscQueue {
+    std::vector<T> buffer;
+    size_t mask;
+    alignas(kCacheLine) std::atomic<size_t> head{0};
+    size_t cached_tail = 0;
+    alignas(kCacheLine) std::atomic<size_t> tail{0};
+    size_t cached_head = 0;
+
+    explicit SpscQueue(size_t capacity) {
+        size_t n = 1;
+        while (n < capacity)
+            n *= 2;
+        buffer.resize(n);
+        mask = n - 1;
+    }
+
+    bool push(T const &value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cached_head > mask) {
+            cached_head = head.load(std::memory_order_acquire);
+            if (t - cached_head > mask)
+                return false;
+        }
+        buffer[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &value) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == cached_tail) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (h == cached_tail)
+                return false;
+        }
+        value = buffer[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+// bounded multi producer multi consumer queue after Dmitry Vyukov, each
+// cell carries a sequence number telling whose turn it is
+template <class T>
+struct MpmcQueue {
+    struct alignas(kCacheLine) Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    Cell *cells;
+    size_t mask;
+    alignas(kCacheLine) std::atomic<size_t> enqueue_pos{0};
+    alignas(kCacheLine) std::atomic<size_t> dequeue_pos{0};
+
+    explicit MpmcQueue(size_t capacity) {
+        size_t n = 2;
+        while (n < capacity)
+            n *= 2;
+        // new[] ignores alignas before C++17, which would let cells
+        // straddle lines and measure false sharing instead
+        cells = (Cell *)hermes::alloc(n * sizeof(Cell));
+        mask = n - 1;
+        for (size_t i = 0; i < n; i++) {
+            new (&cells[i]) Cell();
+            cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcQueue(MpmcQueue &&) = delete;
+
+    ~MpmcQueue() {
+        for (size_t i = 0; i <= mask; i++)
+            cells[i].~Cell();
+        hermes::dealloc(cells);
+    }
+
+    bool push(T const &value) {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell = cells[pos & mask];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop(T &value) {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell = cells[pos & mask];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = cell.value;
+                    cell.seq.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+template <class Op>
+void rmw_contention(hermes::State &h, Op op) {
+    size_t nthreads = h.arg(0);
+    alignas(kCacheLine) std::atomic<int64_t> shared{0};
+    {
+        Helpers helpers(nthreads - 1, [&] (size_t, std::atomic<bool> &stop) {
+            while (!stop.load(std::memory_order_relaxed))
+                op(shared);
+        });
+        for (auto _: h) {
+            op(shared);
+        }
+    }
+    h.set_items_processed(h.iterations());
+}
+
+template <class Lock>
+void lock_contention(hermes::State &h) {
+    size_t nthreads = h.arg(0);
+    Lock lock;
+    int64_t counter = 0;
+    {
+        Helpers helpers(nthreads - 1, [&] (size_t, std::atomic<bool> &stop) {
+            while (!stop.load(std::memory_order_relaxed)) {
+                std::lock_guard<Lock> guard(lock);
+                ++counter;
+            }
+        });
+        for (auto _: h) {
+            std::lock_guard<Lock> guard(lock);
+            ++counter;
+        }
+    }
+    hermes::do_not_optimize(counter);
+    h.set_items_processed(h.iterations());
+}
+
+}
+
+// cache line round trip between two cores, half of it is the one-way latency
+BENCHMARK(BM_pingpong, {cpus, cpus}) {
+    int64_t a = h.arg(0), b = h.arg(1);
+    if (a == b) {
+        h.skip();
+        return;
+    }
+    ScopedPin pin(a);
+    alignas(kCacheLine) std::atomic<int64_t> seq{0};
+    std::thread partner([&] {
+        pin_thread(b);
+        int64_t last = 0;
+        for (;;) {
+            int64_t s;
+            spin_until([&] { s = seq.load(std::memory_order_acquire); return s != last; });
+            if (s < 0)
+                return;
+            last = s + 1;
+            seq.store(last, std::memory_order_release);
+        }
+    });
+    int64_t s = 0;
+    for (auto _: h) {
+        seq.store(++s, std::memory_order_release);
+        ++s;
+        spin_until([&] { return seq.load(std::memory_order_acquire) == s; });
+    }
+    seq.store(-1, std::memory_order_release);
+    partner.join();
+    h.set_items_processed(h.iterations() * 2);
+}
+
+BENCHMARK(BM_atomic_fetch_add, {thread_range()}) {
+    rmw_contention(h, [] (std::atomic<int64_t> &x) {
+        x.fetch_add(1);
+    });
+}
+
+BENCHMARK(BM_atomic_exchange, {thread_range()}) {
+    rmw_contention(h, [] (std::atomic<int64_t> &x) {
+        x.exchange(1);
+    });
+}
+
+BENCHMARK(BM_atomic_cas, {thread_range()}) {
+    rmw_contention(h, [] (std::atomic<int64_t> &x) {
+        int64_t v = x.load(std::memory_order_relaxed);
+        while (!x.compare_exchange_weak(v, v + 1)) {
+        }
+    });
+}
+
+// every thread increments its own counter, stride bytes apart from the
+// next one, counters closer than the coherence granularity falsely share
+BENCHMARK(BM_false_sharing, {thread_range(), {8, 16, 32, 64, 128, 256}}) {
+    size_t nthreads = h.arg(0);
+    size_t stride = h.arg(1);
+    auto buf = (char *)hermes::alloc(stride * nthreads + kCacheLine);
+    auto counter = [&] (size_t i) {
+        return (std::atomic<int64_t> *)(buf + i * stride);
+    };
+    {
+        Helpers helpers(nthreads - 1, [&] (size_t i, std::atomic<bool> &stop) {
+            auto c = counter(i + 1);
+            while (!stop.load(std::memory_order_relaxed))
+                c->store(c->load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        });
+        auto c = counter(0);
+        for (auto _: h) {
+            c->store(c->load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+    hermes::dealloc(buf);
+    h.set_items_processed(h.iterations());
+}
+
+BENCHMARK(BM_spinlock, {thread_range()}) {
+    lock_contention<Spinlock>(h);
+}
+
+BENCHMARK(BM_mutex, {thread_range()}) {
+    lock_contention<std::mutex>(h);
+}
+
+// consumer side throughput while a producer keeps the queue busy
+BENCHMARK(BM_spsc_throughput, {hermes::log_range(2, 1 << 16, 4)}) {
+    SpscQueue<int64_t> queue(h.arg(0));
+    {
+        Helpers producer(1, [&] (size_t, std::atomic<bool> &stop) {
+            int64_t i = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (queue.push(i))
+                    ++i;
+            }
+        });
+        int64_t value = 0;
+        for (auto _: h) {
+            spin_until([&] { return queue.pop(value); });
+            hermes::do_not_optimize(value);
+        }
+    }
+    h.set_items_processed(h.iterations());
+}
+
+// message round trip through a pair of queues, half of it is the latency
+BENCHMARK(BM_spsc_latency, {hermes::log_range(2, 1 << 16, 4)}) {
+    SpscQueue<int64_t> ping(h.arg(0)), pong(h.arg(0));
+    {
+        Helpers echo(1, [&] (size_t, std::atomic<bool> &stop) {
+            int64_t value;
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (ping.pop(value))
+                    spin_until([&] { return pong.push(value); });
+            }
+        });
+        int64_t value = 0;
+        for (auto _: h) {
+            spin_until([&] { return ping.push(value); });
+            spin_until([&] { return pong.pop(value); });
+        }
+    }
+    h.set_items_processed(h.iterations() * 2);
+}
+
+// consumer side throughput with n - 1 producers contending on the tail
+BENCHMARK(BM_mpmc_throughput, {thread_range()}) {
+    size_t nthreads = h.arg(0);
+    MpmcQueue<int64_t> queue(1024);
+    {
+        Helpers producers(std::max<size_t>(nthreads - 1, 1), [&] (size_t, std::atomic<bool> &stop) {
+            int64_t i = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (queue.push(i))
+                    ++i;
+            }
+        });
+        int64_t value = 0;
+        for (auto _: h) {
+            spin_until([&] { return queue.pop(value); });
+            hermes::do_not_optimize(value);
+        }
+    }
+    h.set_items_processed(h.iterations());
+}
+
+BENCHMARK(BM_mpmc_latency, {hermes::log_range(2, 1 << 16, 4)}) {
+    MpmcQueue<int64_t> ping(h.arg(0)), pong(h.arg(0));
+    {
+        Helpers echo(1, [&] (size_t, std::atomic<bool> &stop) {
+            int64_t value;
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (ping.pop(value))
+                    spin_until([&] { return pong.push(value); });
+            }
+        });
+        int64_t value = 0;
+        for (auto _: h) {
+            spin_until([&] { return ping.push(value); });
+            spin_until([&] { return pong.pop(value); });
+        }
+    }
+    h.set_items_processed(h.iterations() * 2);
+}
+
+namespace {
+
+// collects BM_pingpong into a core-to-core matrix and looks for the
+// stride at which BM_false_sharing stops paying for shared lines
+struct TopologyReporter : hermes::Reporter {
+    std::map<std::pair<int64_t, int64_t>, double> latency;
+    std::map<int64_t, std::map<int64_t, double>> sharing;
+
+    void write_report(const char *name, Row const &row) override {
+        (void)name;
+        (void)row;
+    }
+
+    void write_instance(hermes::Instance const &inst, Row const &row) override {
+        std::string entry = inst.entry->name;
+        if (entry == "BM_pingpong")
+            latency[{inst.args[0], inst.args[1]}] = row.med;
+        else if (entry == "BM_false_sharing")
+            sharing[inst.args[0]][inst.args[1]] = row.med;
+    }
+
+    ~TopologyReporter() {
+        if (!latency.empty()) {
+            printf("\ncore-to-core one-way latency (ticks):\n%6s", "");
+            for (int64_t b: cpus)
+                printf(" %6ld", (long)b);
+            printf("\n");
+            for (int64_t a: cpus) {
+                printf("%6ld", (long)a);
+                for (int64_t b: cpus) {
+                    auto it = latency.find({a, b});
+                    if (it == latency.end())
+                        printf(" %6s", "-");
+                    else
+                        printf(" %6.0lf", it->second);
+                }
+                printf("\n");
+            }
+        }
+        for (auto const &kv: sharing) {
+            if (kv.first < 2 || kv.second.empty())
+                continue;
+            double best = kv.second.rbegin()->second;
+            int64_t granularity = 0;
+            for (auto const &s: kv.second) {
+                if (s.second <= best * 1.5) {
+                    granularity = s.first;
+                    break;
+                }
+            }
+            double worst = kv.second.begin()->second;
+            printf("\nfalse sharing with %ld threads: %.1lfx slowdown below %ld byte stride\n",
+                   (long)kv.first, best > 0 ? worst / best : 0.0, (long)granularity);
+        }
+    }
+};
+
+}
+
+int main(int argc, char **argv) {
+    hermes::Options options = hermes::parse_args(argc, argv);
+    std::unique_ptr<hermes::Reporter> rep(hermes::makeMultipleReporter({
+            hermes::makeConsoleReporter(),
+            hermes::makeSweepReporter("concurrency.svg"),
+            new TopologyReporter(),
+    }));
+    rep->run_all(options);
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include "hermes_coro.hpp"
+#include <memory>
+
+namespace {
+
+hermes::coro::Task<int> nested(int depth) {
+    if (depth == 0) {
+        co_await hermes::coro::yield();
+        co_return 1;
+    }
+    co_return co_await nested(depth - 1) + 1;
+}
+
+}
+
+// one trip through the ready queue, with depth coroutines taking turns
+BENCHMARK(BM_coro_yield, {hermes::log_range(1, 1024, 4)}) {
+    hermes::coro::run(h, h.arg(0), [] {
+        return hermes::coro::yield();
+    });
+}
+
+// a chain of nested tasks, exercising symmetric transfer on both ends
+BENCHMARK(BM_coro_task_chain, {{1}, {1, 4, 16, 64}}) {
+    int chain = h.arg(1);
+    hermes::coro::run(h, h.arg(0), [chain] {
+        return nested(chain);
+    });
+}
+
+// timer wakeups, the latency above the requested delay is loop overhead
+BENCHMARK(BM_coro_sleep, {hermes::log_range(1, 1024, 4), {1000}}) {
+    int64_t ticks = h.arg(1);
+    hermes::coro::run(h, h.arg(0), [ticks] {
+        return hermes::coro::sleep_for(ticks);
+    });
+}
+
+int main(int argc, char **argv) {
+    hermes::Options options = hermes::parse_args(argc, argv);
+    std::unique_ptr<hermes::Reporter> rep(hermes::makeMultipleReporter({
+            hermes::makeConsoleReporter(),
+            hermes::makeSweepReporter("coro.svg"),
+    }));
+    rep->run_all(options);
+    return 0;
+}
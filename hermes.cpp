@@ -1,20 +1,36 @@
 #include "hermes.hpp"
+#include <chrono>
+#include <cerrno>
 #include <cmath>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <algorithm>
+#include <map>
 #include <memory>
+#include <random>
+#include <set>
 #include <string>
 #include <vector>
 #if __linux__
+#include <alloca.h>
+#include <dirent.h>
+#include <elf.h>
 #include <fcntl.h>
+#include <link.h>
+#include <poll.h>
 #include <sched.h>
+#include <signal.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #elif __APPLE__
 #include <mach/mach_time.h>
 #elif _WIN32
+#include <malloc.h>
 #include <windows.h>
 #endif
 
@@ -27,6 +43,11 @@ std::vector<Entry> &entries() {
     return instance;
 }
 
+std::map<void (*)(State &), std::vector<void (*)(State &)>> &layouts() {
+    static std::map<void (*)(State &), std::vector<void (*)(State &)>> instance;
+    return instance;
+}
+
 int64_t get_cpu_freq() {
 #if __linux__
     int fd;
@@ -129,6 +150,597 @@ T find_median(T *begin, size_t n) {
     }
 }
 
+uint64_t fnv1a(const void *data, size_t size, uint64_t h = 14695981039346656037ull) {
+    auto p = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+template <class T>
+uint64_t fnv1a_value(T const &value, uint64_t h) {
+    return fnv1a(&value, sizeof(value), h);
+}
+
+uint64_t fnv1a_string(std::string const &str, uint64_t h) {
+    return fnv1a(str.data(), str.size() + 1, h);
+}
+
+#if __linux__
+// resolves benchmark functions and their callees from the ELF symbol table of
+// our own executable, so that their machine code can be hashed
+struct SymbolTable {
+    struct Symbol {
+        uint64_t addr;
+        uint64_t size;
+        std::string name;
+    };
+
+    std::vector<Symbol> symbols;
+    std::vector<std::pair<uint64_t, uint64_t>> plt_ranges;
+    uintptr_t bias = 0;
+    // identity of the shared libraries loaded, what PLT calls resolve to
+    uint64_t libraries = 0;
+    std::map<uint64_t, uint64_t> memo;
+
+    // hashes the GNU build-id of every shared object, or its name, size and
+    // mtime when it has none, so that updating libc invalidates memcpy users
+    static int hash_library(struct dl_phdr_info *info, size_t, void *data) {
+        uint64_t &h = *(uint64_t *)data;
+        if (!info->dlpi_name[0])
+            return 0;
+        h = fnv1a(info->dlpi_name, strlen(info->dlpi_name), h);
+        for (int i = 0; i < info->dlpi_phnum; i++) {
+            ElfW(Phdr) const &phdr = info->dlpi_phdr[i];
+            if (phdr.p_type != PT_NOTE)
+                continue;
+            auto p = (const char *)(info->dlpi_addr + phdr.p_vaddr);
+            auto end = p + phdr.p_memsz;
+            while (p + sizeof(ElfW(Nhdr)) <= end) {
+                auto note = (ElfW(Nhdr) const *)p;
+                const char *name = p + sizeof *note;
+                const char *desc = name + ((note->n_namesz + 3) & ~3u);
+                if (note->n_type == NT_GNU_BUILD_ID && note->n_namesz == 4 && !memcmp(name, "GNU", 4)) {
+                    h = fnv1a(desc, note->n_descsz, h);
+                    return 0;
+                }
+                p = desc + ((note->n_descsz + 3) & ~3u);
+            }
+        }
+        struct stat st;
+        if (!stat(info->dlpi_name, &st)) {
+            h = fnv1a_value(st.st_size, h);
+            h = fnv1a_value(st.st_mtime, h);
+        }
+        return 0;
+    }
+
+    SymbolTable() {
+        dl_iterate_phdr([] (struct dl_phdr_info *info, size_t, void *data) {
+            *(uintptr_t *)data = info->dlpi_addr;
+            return 1;
+        }, &bias);
+        libraries = 14695981039346656037ull;
+        dl_iterate_phdr(hash_library, &libraries);
+
+        FILE *fp = fopen("/proc/self/exe", "rb");
+        if (!fp)
+            return;
+        std::string image;
+        char buf[65536];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof buf, fp)) > 0)
+            image.append(buf, n);
+        fclose(fp);
+
+        if (image.size() < sizeof(Elf64_Ehdr) || memcmp(image.data(), ELFMAG, SELFMAG)
+            || image[EI_CLASS] != ELFCLASS64)
+            return;
+        auto ehdr = (Elf64_Ehdr const *)image.data();
+        if (ehdr->e_shoff + (uint64_t)ehdr->e_shnum * sizeof(Elf64_Shdr) > image.size())
+            return;
+        auto shdrs = (Elf64_Shdr const *)(image.data() + ehdr->e_shoff);
+        const char *shstrtab = image.data() + shdrs[ehdr->e_shstrndx].sh_offset;
+
+        for (size_t i = 0; i < ehdr->e_shnum; i++) {
+            if (!strncmp(shstrtab + shdrs[i].sh_name, ".plt", 4))
+                plt_ranges.emplace_back(shdrs[i].sh_addr, shdrs[i].sh_addr + shdrs[i].sh_size);
+        }
+        for (size_t i = 0; i < ehdr->e_shnum; i++) {
+            if (shdrs[i].sh_type != SHT_SYMTAB)
+                continue;
+            auto syms = (Elf64_Sym const *)(image.data() + shdrs[i].sh_offset);
+            size_t nsyms = shdrs[i].sh_size / sizeof(Elf64_Sym);
+            const char *strtab = image.data() + shdrs[shdrs[i].sh_link].sh_offset;
+            for (size_t j = 0; j < nsyms; j++) {
+                if (ELF64_ST_TYPE(syms[j].st_info) != STT_FUNC || !syms[j].st_value || !syms[j].st_size)
+                    continue;
+                symbols.push_back({syms[j].st_value, syms[j].st_size, strtab + syms[j].st_name});
+            }
+        }
+        std::sort(symbols.begin(), symbols.end(), [] (Symbol const &a, Symbol const &b) {
+            return a.addr < b.addr;
+        });
+    }
+
+    Symbol const *at(uint64_t addr) const {
+        auto it = std::lower_bound(symbols.begin(), symbols.end(), addr, [] (Symbol const &s, uint64_t a) {
+            return s.addr < a;
+        });
+        if (it == symbols.end() || it->addr != addr)
+            return nullptr;
+        return &*it;
+    }
+
+    bool in_plt(uint64_t addr) const {
+        for (auto const &r: plt_ranges) {
+            if (addr >= r.first && addr < r.second)
+                return true;
+        }
+        return false;
+    }
+
+    // hashes the code bytes of a function together with all functions it
+    // calls directly, call displacements are replaced by the callee hash so
+    // that unrelated code moving around doesn't invalidate the result
+    uint64_t hash(Symbol const &sym, std::set<uint64_t> &visiting) {
+        auto it = memo.find(sym.addr);
+        if (it != memo.end())
+            return it->second;
+        uint64_t h = fnv1a_string(sym.name, 14695981039346656037ull);
+        if (!visiting.insert(sym.addr).second)
+            return h;
+        auto code = (const unsigned char *)(bias + sym.addr);
+        size_t i = 0;
+        while (i < sym.size) {
+#if __x86_64__
+            if ((code[i] == 0xe8 || code[i] == 0xe9) && i + 5 <= sym.size) {
+                int32_t rel;
+                memcpy(&rel, code + i + 1, sizeof rel);
+                uint64_t target = sym.addr + i + 5 + rel;
+                if (Symbol const *callee = at(target)) {
+                    h = fnv1a_value(hash(*callee, visiting), fnv1a(code + i, 1, h));
+                    i += 5;
+                    continue;
+                } else if (in_plt(target)) {
+                    h = fnv1a_value(libraries, fnv1a("plt", 3, fnv1a(code + i, 1, h)));
+                    i += 5;
+                    continue;
+                }
+            }
+#endif
+            h = fnv1a(code + i, 1, h);
+            ++i;
+        }
+        visiting.erase(sym.addr);
+        memo.emplace(sym.addr, h);
+        return h;
+    }
+
+    uint64_t hash(void (*func)(State &)) {
+        Symbol const *sym = at((uintptr_t)func - bias);
+        if (!sym)
+            return 0;
+        std::set<uint64_t> visiting;
+        return hash(*sym, visiting);
+    }
+};
+#endif
+
+uint64_t code_hash(Entry const &ent) {
+#if __linux__
+    static SymbolTable symtab;
+    return symtab.hash(ent.func);
+#else
+    (void)ent;
+    return 0;
+#endif
+}
+
+int64_t parse_arg(const char *str) {
+    char *end;
+    int64_t value = strtoll(str, &end, 10);
+    switch (*end) {
+    case 'G':
+        value *= 1024;
+        /* fallthrough */
+    case 'M':
+        value *= 1024;
+        /* fallthrough */
+    case 'k':
+        value *= 1024;
+        break;
+    }
+    return value;
+}
+
+std::string format_arg(int64_t value) {
+    if (value == 0) {
+        return "0";
+    } else if (value % (1024 * 1024 * 1024) == 0) {
+        return std::to_string(value / (1024 * 1024 * 1024)) + 'G';
+    } else if (value % (1024 * 1024) == 0) {
+        return std::to_string(value / (1024 * 1024)) + 'M';
+    } else if (value % 1024 == 0) {
+        return std::to_string(value / 1024) + 'k';
+    } else {
+        return std::to_string(value);
+    }
+}
+
+std::vector<Instance> expand_entry(Entry const &ent) {
+    std::vector<Instance> instances;
+    size_t nargs = ent.args.size();
+    for (auto const &values: ent.args) {
+        if (values.empty())
+            return instances;
+    }
+    std::vector<size_t> indices(nargs, 0);
+    bool done;
+    do {
+        Instance inst{&ent, ent.name, std::vector<int64_t>(nargs)};
+        for (size_t i = 0; i < nargs; i++) {
+            int64_t value = ent.args[i][indices[i]];
+            inst.args[i] = value;
+            inst.name += '/';
+            inst.name += format_arg(value);
+        }
+        instances.push_back(std::move(inst));
+
+        done = true;
+        for (size_t i = 0; i < nargs; i++) {
+            ++indices[i];
+            if (indices[i] >= ent.args[i].size()) {
+                indices[i] = 0;
+                continue;
+            } else {
+                done = false;
+                break;
+            }
+        }
+    } while (!done);
+    return instances;
+}
+
+// every host field, not just the decisive ones of HostInfo::fingerprint, so
+// that a kernel or microcode upgrade invalidates cached results; the tick
+// rate is left out, being measured it differs slightly on every run
+std::string host_key() {
+    std::string key;
+    for (auto const &f: host_info().fields()) {
+        if (f.first != "tick_ghz")
+            key += f.first + '=' + f.second + '\n';
+    }
+    return key;
+}
+
+uint64_t instance_key(uint64_t code, Instance const &inst, Options const &options) {
+    static const std::string host = host_key();
+    uint64_t h = fnv1a_value(code, 14695981039346656037ull);
+    h = fnv1a_string(inst.name, h);
+    for (int64_t value: inst.args)
+        h = fnv1a_value(value, h);
+    h = fnv1a_string(host, h);
+    h = fnv1a_value(options.max_time, h);
+    h = fnv1a_value(options.deviation_filter, h);
+    h = fnv1a_value(options.schedule, h);
+    if (options.schedule == Schedule::Interleaved || options.randomize_layout)
+        h = fnv1a_value(options.rounds, h);
+    h = fnv1a_value(options.randomize_layout, h);
+    h = fnv1a_value(options.sample_every, h);
+    h = fnv1a_value(options.sample_random, h);
+    h = fnv1a_value(options.max_samples, h);
+    h = fnv1a_value(options.measure_energy, h);
+    return h;
+}
+
+struct ResultCache {
+    struct Record {
+        std::string name;
+        Reporter::Row row;
+    };
+
+    std::string path;
+    std::map<uint64_t, Record> records;
+    size_t hits = 0;
+    size_t misses = 0;
+
+    explicit ResultCache(std::string path_) : path(std::move(path_)) {
+        FILE *fp = fopen(path.c_str(), "r");
+        if (!fp)
+            return;
+        char line[1024];
+        while (fgets(line, sizeof line, fp)) {
+            unsigned long long key;
+            Reporter::Row row;
+            long long count;
+            char name[512];
+            int end = 0;
+            if (sscanf(line, "%llx %lf %lf %lf %lf %lf %lld %511s%n", &key,
+                       &row.med, &row.avg, &row.stddev, &row.min, &row.max, &count, name, &end) != 8)
+                continue;
+            row.count = count;
+            char counter[256];
+            double value;
+            int n;
+            for (char *p = line + end; sscanf(p, " %255[^=]=%lf%n", counter, &value, &n) == 2; p += n) {
+                if (!strcmp(counter, "@pkg_joules"))
+                    row.pkg_joules = value;
+                else if (!strcmp(counter, "@dram_joules"))
+                    row.dram_joules = value;
+                else if (!strcmp(counter, "@pkg_watts"))
+                    row.pkg_watts = value;
+                else if (!strcmp(counter, "@dram_watts"))
+                    row.dram_watts = value;
+                else
+                    row.counters.emplace_back(counter, value);
+            }
+            records[key] = Record{name, row};
+        }
+        fclose(fp);
+    }
+
+    bool lookup(uint64_t key, Reporter::Row &row) {
+        auto it = records.find(key);
+        if (it == records.end()) {
+            ++misses;
+            return false;
+        }
+        row = it->second.row;
+        row.cached = true;
+        ++hits;
+        return true;
+    }
+
+    void store(uint64_t key, std::string const &name, Reporter::Row const &row) {
+        // drop stale results of the same benchmark, they'll never hit again
+        for (auto it = records.begin(); it != records.end();) {
+            if (it->second.name == name && it->first != key)
+                it = records.erase(it);
+            else
+                ++it;
+        }
+        records[key] = Record{name, row};
+        save();
+    }
+
+    void save() const {
+        std::string tmp = path + ".tmp";
+        FILE *fp = fopen(tmp.c_str(), "w");
+        if (!fp)
+            return;
+        for (auto const &kv: records) {
+            Reporter::Row const &row = kv.second.row;
+            fprintf(fp, "%016llx %.17g %.17g %.17g %.17g %.17g %lld %s", (unsigned long long)kv.first,
+                    row.med, row.avg, row.stddev, row.min, row.max, (long long)row.count, kv.second.name.c_str());
+            for (auto const &c: row.counters)
+                fprintf(fp, " %s=%.17g", c.first.c_str(), c.second);
+            if (!std::isnan(row.pkg_joules))
+                fprintf(fp, " @pkg_joules=%.17g @pkg_watts=%.17g", row.pkg_joules, row.pkg_watts);
+            if (!std::isnan(row.dram_joules))
+                fprintf(fp, " @dram_joules=%.17g @dram_watts=%.17g", row.dram_joules, row.dram_watts);
+            fprintf(fp, "\n");
+        }
+        fclose(fp);
+        rename(tmp.c_str(), path.c_str());
+    }
+};
+
+// RAPL energy counters exposed by the powercap framework, summed over all
+// packages; the counters are in microjoules and wrap at max_energy_range_uj
+struct EnergyMeter {
+    struct Domain {
+        std::string path;
+        double range;
+        bool dram;
+    };
+
+    struct Reading {
+        std::vector<double> uj;
+        int64_t ns;
+    };
+
+    std::vector<Domain> domains;
+    bool has_pkg = false;
+    bool has_dram = false;
+
+    static bool read_number(std::string const &path, double &value) {
+        FILE *fp = fopen(path.c_str(), "r");
+        if (!fp)
+            return false;
+        bool ok = fscanf(fp, "%lf", &value) == 1;
+        fclose(fp);
+        return ok;
+    }
+
+    explicit EnergyMeter(std::string const &root) {
+#if __linux__
+        DIR *dir = opendir(root.c_str());
+        if (!dir)
+            return;
+        while (struct dirent *ent = readdir(dir)) {
+            // intel-rapl:0 is a package, intel-rapl:0:1 one of its subzones
+            // (core, uncore or dram); the mmio mirror would double count
+            if (strncmp(ent->d_name, "intel-rapl:", 11))
+                continue;
+            std::string zone = root + "/" + ent->d_name + "/";
+            char name[64] = {};
+            FILE *fp = fopen((zone + "name").c_str(), "r");
+            if (!fp)
+                continue;
+            bool named = fscanf(fp, "%63s", name) == 1;
+            fclose(fp);
+            bool dram = named && !strcmp(name, "dram");
+            if (!named || (!dram && strncmp(name, "package", 7)))
+                continue;
+            // energy_uj is root only on kernels after the PLATYPUS attack
+            double value, range;
+            if (!read_number(zone + "energy_uj", value))
+                continue;
+            if (!read_number(zone + "max_energy_range_uj", range))
+                range = 0;
+            domains.push_back(Domain{zone + "energy_uj", range, dram});
+            (dram ? has_dram : has_pkg) = true;
+        }
+        closedir(dir);
+#endif
+    }
+
+    Reading read() const {
+        Reading r;
+        for (auto const &d: domains) {
+            double value = NAN;
+            read_number(d.path, value);
+            r.uj.push_back(value);
+        }
+        r.ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        return r;
+    }
+
+    // joules of each kind spent between two readings
+    void add(Reading const &a, Reading const &b, double &pkg, double &dram) const {
+        for (size_t i = 0; i < domains.size(); i++) {
+            double delta = b.uj[i] - a.uj[i];
+            if (std::isnan(delta))
+                continue;
+            if (delta < 0)
+                delta += domains[i].range;
+            (domains[i].dram ? dram : pkg) += delta * 1e-6;
+        }
+    }
+};
+
+EnergyMeter const *energy_meter(const char *path) {
+    static std::map<std::string, std::unique_ptr<EnergyMeter>> meters;
+    auto &meter = meters[path];
+    if (!meter)
+        meter.reset(new EnergyMeter(path));
+    return meter->domains.empty() ? nullptr : meter.get();
+}
+
+ResultCache &result_cache(const char *path) {
+    static std::map<std::string, std::unique_ptr<ResultCache>> caches;
+    auto &cache = caches[path];
+    if (!cache)
+        cache.reset(new ResultCache(path));
+    return *cache;
+}
+
+// shifts the stack of func by offset bytes, which is what a different
+// environment size would do to it at process startup
+HERMES_NOINLINE void run_with_stack_offset(void (*func)(State &), State &state, size_t offset) {
+#if _WIN32
+    volatile char *pad = (volatile char *)_alloca(offset + 16);
+#else
+    volatile char *pad = (volatile char *)alloca(offset + 16);
+#endif
+    pad[0] = 0;
+    func(state);
+}
+
+// runs body in a forked child and collects the string it returns, killing
+// the child once timeout_ns (-1 for none) have passed
+template <class Body>
+RunStatus run_forked(Body const &body, int64_t timeout_ns, std::string &out, int &code) {
+    code = 0;
+#if __linux__
+    int fds[2];
+    if (pipe(fds) == 0) {
+        // nothing buffered may be written twice, by parent and child
+        fflush(nullptr);
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            std::string data = body();
+            for (size_t done = 0; done < data.size();) {
+                ssize_t n = write(fds[1], data.data() + done, data.size() - done);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    _exit(1);
+                done += n;
+            }
+            fflush(nullptr);
+            _exit(0);
+        }
+        close(fds[1]);
+        if (pid < 0) {
+            close(fds[0]);
+            code = errno;
+            return RunStatus::Failed;
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        bool timed_out = false;
+        char buf[65536];
+        for (;;) {
+            int wait_ms = -1;
+            if (timeout_ns >= 0) {
+                int64_t left = timeout_ns - std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - t0).count();
+                if (left <= 0) {
+                    timed_out = true;
+                    break;
+                }
+                wait_ms = (int)std::min<int64_t>(left / 1000000 + 1, 1 << 30);
+            }
+            struct pollfd pfd = {fds[0], POLLIN, 0};
+            int r = poll(&pfd, 1, wait_ms);
+            if (r <= 0)
+                continue;
+            ssize_t n = read(fds[0], buf, sizeof buf);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            out.append(buf, n);
+        }
+        close(fds[0]);
+        if (timed_out)
+            kill(pid, SIGKILL);
+        int wstatus = 0;
+        while (waitpid(pid, &wstatus, 0) < 0 && errno == EINTR) {
+        }
+        if (timed_out)
+            return RunStatus::Timeout;
+        if (WIFSIGNALED(wstatus)) {
+            code = WTERMSIG(wstatus);
+            return RunStatus::Crashed;
+        }
+        code = WEXITSTATUS(wstatus);
+        return code ? RunStatus::Failed : RunStatus::Ok;
+    }
+#endif
+    // no fork here, run unsupervised
+    (void)timeout_ns;
+    out = body();
+    return RunStatus::Ok;
+}
+
+// splits the spread of the per round medians into what the measurement
+// noise explains and what's left, which is put down to layout
+void add_layout_counters(Reporter::Row &row, std::vector<Reporter::Row> const &rounds) {
+    size_t n = rounds.size();
+    if (n < 2)
+        return;
+    double mean = 0;
+    for (auto const &r: rounds)
+        mean += r.med / n;
+    double between = 0;
+    double noise = 0;
+    double median_error = 0;
+    for (auto const &r: rounds) {
+        between += (r.med - mean) * (r.med - mean) / (n - 1);
+        noise += r.stddev * r.stddev / n;
+        if (r.count)
+            median_error += M_PI / 2 * r.stddev * r.stddev / r.count / n;
+    }
+    row.counters.emplace_back("layout_std", std::sqrt(std::max(between - median_error, 0.0)));
+    row.counters.emplace_back("noise_std", std::sqrt(noise));
+}
+
 }
 
 int register_entry(Entry ent) {
@@ -136,62 +748,377 @@ int register_entry(Entry ent) {
     return 1;
 }
 
+int register_layouts(void (*func)(State &), std::vector<void (*)(State &)> variants) {
+    layouts()[func] = std::move(variants);
+    return 1;
+}
+
+void State::merge(State &other) {
+    rec_chunks_tail->next = other.rec_chunks;
+    rec_chunks_tail = other.rec_chunks_tail;
+    nchunks += other.nchunks;
+    other.rec_chunks = other.rec_chunks_tail = nullptr;
+    iteration_count += other.iteration_count;
+    time_elapsed += other.time_elapsed;
+    block_iterations += other.block_iterations;
+    block_time += other.block_time;
+    items_processed += other.items_processed;
+    caller_timed |= other.caller_timed;
+    skipped |= other.skipped;
+    for (auto const &c: other.counters)
+        set_counter(c.first.c_str(), c.second);
+    // each trial kept within the bound, together they may not
+    if (max_samples) {
+        size_t total = 0;
+        for (Chunk *chunk = rec_chunks; chunk; chunk = chunk->next)
+            total += chunk->count;
+        for (; total > max_samples; total -= total / 2)
+            decimate();
+    }
+}
+
+std::string State::serialize() const {
+    std::string data;
+    auto put = [&] (int64_t x) {
+        data.append((const char *)&x, sizeof x);
+    };
+    int64_t nrecords = 0;
+    for (Chunk *chunk = rec_chunks; chunk; chunk = chunk->next)
+        nrecords += chunk->count;
+    put(iteration_count);
+    put(time_elapsed);
+    put(block_iterations);
+    put(block_time);
+    put(items_processed);
+    put(caller_timed);
+    put(skipped);
+    put(nrecords);
+    for (Chunk *chunk = rec_chunks; chunk; chunk = chunk->next)
+        data.append((const char *)chunk->records, chunk->count * sizeof(int64_t));
+    put(counters.size());
+    for (auto const &c: counters) {
+        put(c.first.size());
+        data += c.first;
+        data.append((const char *)&c.second, sizeof c.second);
+    }
+    return data;
+}
+
+bool State::deserialize(std::string const &data) {
+    size_t pos = 0;
+    auto get = [&] (void *p, size_t n) {
+        if (data.size() - pos < n)
+            return false;
+        memcpy(p, data.data() + pos, n);
+        pos += n;
+        return true;
+    };
+    int64_t header[8];
+    if (!get(header, sizeof header))
+        return false;
+    iteration_count = header[0];
+    time_elapsed = header[1];
+    block_iterations = header[2];
+    block_time = header[3];
+    items_processed = header[4];
+    caller_timed = header[5] != 0;
+    skipped = header[6] != 0;
+    for (int64_t left = header[7]; left > 0;) {
+        Chunk &chunk = *rec_chunks_tail;
+        size_t n = std::min<size_t>(left, Chunk::kMaxPerChunk - chunk.count);
+        if (!get(chunk.records + chunk.count, n * sizeof(int64_t)))
+            return false;
+        chunk.count += n;
+        left -= n;
+        if (chunk.count == Chunk::kMaxPerChunk) {
+            rec_chunks_tail->next = new Chunk();
+            rec_chunks_tail = rec_chunks_tail->next;
+            ++nchunks;
+        }
+    }
+    int64_t ncounters;
+    if (!get(&ncounters, sizeof ncounters))
+        return false;
+    for (int64_t i = 0; i < ncounters; i++) {
+        int64_t len;
+        double value;
+        if (!get(&len, sizeof len) || data.size() - pos < (size_t)len)
+            return false;
+        std::string name = data.substr(pos, len);
+        pos += len;
+        if (!get(&value, sizeof value))
+            return false;
+        set_counter(name.c_str(), value);
+    }
+    return pos == data.size();
+}
+
 void Reporter::run_entry(Entry const &ent, Options const &options) {
-    size_t nargs = ent.args.size();
-    if (nargs != 0) {
-        std::vector<size_t> indices(nargs, 0);
-        bool done;
-        do {
-            State state(options);
-
-            std::vector<int64_t> args(nargs);
-            state.args = args.data();
-            state.nargs = nargs;
-
-            std::string new_name = ent.name;
-            for (size_t i = 0; i < nargs; i++) {
-                int64_t value = ent.args[i][indices[i]];
-                args[i] = value;
-                new_name += '/';
-                if (value == 0) {
-                    new_name += '0';
-                } else if (value % (1024 * 1024 * 1024) == 0) {
-                    new_name += std::to_string(value / (1024 * 1024 * 1024)) + 'G';
-                } else if (value % (1024 * 1024) == 0) {
-                    new_name += std::to_string(value / (1024 * 1024)) + 'M';
-                } else if (value % 1024 == 0) {
-                    new_name += std::to_string(value / 1024) + 'k';
-                } else {
-                    new_name += std::to_string(value);
+    run_instances(expand_entry(ent), options);
+}
+
+void Reporter::run_instances(std::vector<Instance> const &instances, Options const &options) {
+    struct Pending {
+        Instance const *inst;
+        uint64_t key;
+        bool cached;
+        Row row;
+        std::unique_ptr<State> state;
+        std::vector<Row> round_rows;
+        double pkg_joules;
+        double dram_joules;
+        int64_t energy_ns;
+        RunStatus status;
+        int status_code;
+        int64_t wall_ns;
+    };
+
+    ResultCache *cache = options.cache_path ? &result_cache(options.cache_path) : nullptr;
+    std::map<Entry const *, uint64_t> codes;
+    std::vector<Pending> pendings;
+    for (Instance const &inst: instances) {
+        Pending p{&inst, 0, false, Row{}, nullptr, {}, 0, 0, 0, RunStatus::Ok, 0, 0};
+        if (cache) {
+            auto it = codes.find(inst.entry);
+            if (it == codes.end())
+                it = codes.emplace(inst.entry, code_hash(*inst.entry)).first;
+            if (it->second) {
+                p.key = instance_key(it->second, inst, options);
+                p.cached = !options.force_rerun && cache->lookup(p.key, p.row);
+            }
+        }
+        pendings.push_back(std::move(p));
+    }
+
+    auto start = [&] (Pending &p) {
+        p.state.reset(new State(options));
+        p.state->args = p.inst->args.data();
+        p.state->nargs = p.inst->args.size();
+    };
+    std::mt19937_64 rng(options.seed ? options.seed : std::random_device{}());
+    EnergyMeter const *meter = options.measure_energy ? energy_meter(options.powercap_path) : nullptr;
+    auto run_trial = [&] (Pending &p, State &trial, int64_t budget, uint64_t jitter, size_t offset) {
+        trial.args = p.state->args;
+        trial.nargs = p.state->nargs;
+        trial.max_time = budget;
+        void (*func)(State &) = p.inst->entry->func;
+        auto it = layouts().find(func);
+        if (options.randomize_layout && it != layouts().end() && !it->second.empty())
+            func = it->second[p.round_rows.size() % it->second.size()];
+        _set_alloc_jitter(jitter);
+        run_with_stack_offset(func, trial, offset);
+        _set_alloc_jitter(0);
+    };
+    auto run_round = [&] (Pending &p, int64_t budget) {
+        State &state = *p.state;
+        if (p.status != RunStatus::Ok || state.skipped)
+            return;
+        EnergyMeter::Reading before{};
+        if (meter)
+            before = meter->read();
+        uint64_t jitter = options.randomize_layout ? rng() | 1 : 0;
+        size_t offset = options.randomize_layout ? 16 * (rng() % 256) : 0;
+        if (options.isolate) {
+            int64_t timeout = -1;
+            if (options.timeout > 0)
+                timeout = std::max<int64_t>((int64_t)(options.timeout * 1e9) - p.wall_ns, 0);
+            auto t0 = std::chrono::steady_clock::now();
+            std::string data;
+            p.status = run_forked([&] {
+                State trial(options);
+                run_trial(p, trial, budget, jitter, offset);
+                return trial.serialize();
+            }, timeout, data, p.status_code);
+            p.wall_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - t0).count();
+            State trial(options);
+            if (p.status == RunStatus::Ok && !trial.deserialize(data))
+                p.status = RunStatus::Failed;
+            if (p.status != RunStatus::Ok)
+                return;
+            if (options.randomize_layout && !trial.skipped)
+                p.round_rows.push_back(summarize(trial));
+            state.merge(trial);
+        } else if (!options.randomize_layout) {
+            state.max_time = state.time_elapsed + budget;
+            p.inst->entry->func(state);
+        } else {
+            State trial(options);
+            run_trial(p, trial, budget, jitter, offset);
+            if (!trial.skipped)
+                p.round_rows.push_back(summarize(trial));
+            state.merge(trial);
+        }
+        if (meter) {
+            EnergyMeter::Reading after = meter->read();
+            meter->add(before, after, p.pkg_joules, p.dram_joules);
+            p.energy_ns += after.ns - before.ns;
+        }
+    };
+    auto finish = [&] (Pending &p) {
+        if (!p.cached && p.status == RunStatus::Ok && p.state->skipped) {
+            p.state.reset();
+            return;
+        }
+        if (!p.cached && p.status != RunStatus::Ok) {
+            p.row = Row{NAN, NAN, NAN, NAN, NAN, 0};
+            p.row.status = p.status;
+            p.row.status_code = p.status_code;
+            p.state.reset();
+        } else if (!p.cached) {
+            p.row = summarize(*p.state);
+            add_layout_counters(p.row, p.round_rows);
+            if (meter && p.energy_ns > 0) {
+                State const &state = *p.state;
+                double units = state.items_processed ? state.items_processed : state.iteration_count;
+                double seconds = p.energy_ns * 1e-9;
+                if (meter->has_pkg) {
+                    p.row.pkg_joules = p.pkg_joules / units;
+                    p.row.pkg_watts = p.pkg_joules / seconds;
+                }
+                if (meter->has_dram) {
+                    p.row.dram_joules = p.dram_joules / units;
+                    p.row.dram_watts = p.dram_joules / seconds;
                 }
             }
+            p.state.reset();
+            if (p.key)
+                cache->store(p.key, p.inst->name, p.row);
+        }
+        write_instance(*p.inst, p.row);
+    };
 
-            ent.func(state);
-            report_state(new_name.c_str(), state);
+    int64_t budget = (int64_t)(options.max_time * 1000000000);
+    int rounds = std::max(options.rounds, 1);
+    if (options.schedule == Schedule::Sequential) {
+        if (!options.randomize_layout)
+            rounds = 1;
+        for (Pending &p: pendings) {
+            if (!p.cached) {
+                start(p);
+                for (int r = 0; r < rounds; r++)
+                    run_round(p, budget / rounds);
+            }
+            finish(p);
+        }
+        return;
+    }
 
-            done = true;
-            for (size_t i = 0; i < nargs; i++) {
-                ++indices[i];
-                if (indices[i] >= ent.args[i].size()) {
-                    indices[i] = 0;
+    // instances sharing an argument tuple (A/B pairs of the same workload)
+    // are grouped, so that they always run right after each other
+    std::map<std::vector<int64_t>, std::vector<Pending *>> groups;
+    for (Pending &p: pendings) {
+        if (!p.cached) {
+            start(p);
+            groups[p.inst->args].push_back(&p);
+        }
+    }
+    std::vector<std::vector<Pending *> *> order;
+    for (auto &kv: groups)
+        order.push_back(&kv.second);
+
+    // cached results are reported right away and the others as soon as
+    // their last round is done, so that only running instances hold samples
+    for (Pending &p: pendings) {
+        if (p.cached)
+            finish(p);
+    }
+    for (int r = 0; r < rounds; r++) {
+        std::shuffle(order.begin(), order.end(), rng);
+        for (auto *group: order) {
+            std::shuffle(group->begin(), group->end(), rng);
+            for (Pending *p: *group) {
+                if (!p->state)
                     continue;
-                } else {
-                    done = false;
-                    break;
-                }
+                run_round(*p, budget / rounds);
+                if (r == rounds - 1 || p->status != RunStatus::Ok || p->state->skipped)
+                    finish(*p);
             }
-        } while (!done);
+        }
+    }
+}
 
-    } else {
-        State state(options);
-        state.max_time = (int64_t)(1000000000 * options.max_time);
+// keeps every other sample, which leaves them spread evenly over the run,
+// packed into as few chunks as they fill
+void State::decimate() {
+    Chunk *wchunk = rec_chunks;
+    size_t windex = 0;
+    size_t index = 0;
+    for (Chunk *chunk = rec_chunks; chunk; chunk = chunk->next) {
+        for (size_t i = 0; i < chunk->count; i++, index++) {
+            if (index % 2)
+                continue;
+            if (windex == Chunk::kMaxPerChunk) {
+                wchunk = wchunk->next;
+                windex = 0;
+            }
+            wchunk->records[windex++] = chunk->records[i];
+        }
+    }
+    wchunk->count = windex;
+    Chunk *garbage = wchunk->next;
+    wchunk->next = nullptr;
+    while (garbage) {
+        Chunk *next = garbage->next;
+        delete garbage;
+        garbage = next;
+    }
+    nchunks = 0;
+    for (Chunk *chunk = rec_chunks; chunk; chunk = chunk->next) {
+        ++nchunks;
+        if (chunk != wchunk)
+            chunk->count = Chunk::kMaxPerChunk;
+    }
+    rec_chunks_tail = wchunk;
+}
 
-        ent.func(state);
-        report_state(ent.name, state);
+void State::grow() {
+    if (max_samples && (nchunks + 1) * Chunk::kMaxPerChunk > max_samples) {
+        // and sample half as often from now on
+        decimate();
+        sample_every *= 2;
+        if (rec_chunks_tail->count < Chunk::kMaxPerChunk)
+            return;
     }
+    Chunk *new_node = new Chunk();
+    rec_chunks_tail->next = new_node;
+    rec_chunks_tail = new_node;
+    ++nchunks;
+}
+
+void State::begin_block() {
+    int64_t n = sample_every - 1;
+    if (sample_random) {
+        // geometric gap, so every iteration is equally likely to be sampled
+        sample_rng ^= sample_rng << 13;
+        sample_rng ^= sample_rng >> 7;
+        sample_rng ^= sample_rng << 17;
+        double u = ((sample_rng >> 11) + 1) * (1.0 / 9007199254740992.0);
+        n = (int64_t)(std::log(u) / std::log1p(-1.0 / sample_every));
+    }
+    if (n <= 0) {
+        start();
+        return;
+    }
+    block_size = n;
+    block_left = n;
+    block_t0 = now();
+}
+
+void Reporter::begin_run(Options const &options, HostInfo const &host) {
+    (void)options;
+    (void)host;
+}
+
+void Reporter::write_instance(Instance const &inst, Row const &row) {
+    write_report(inst.name.c_str(), row);
 }
 
 void Reporter::report_state(const char *name, State &state) {
+    write_report(name, summarize(state));
+}
+
+Reporter::Row Reporter::summarize(State &state) {
     int64_t count = 0;
     int64_t max = INT64_MIN;
     int64_t min = INT64_MAX;
@@ -271,36 +1198,125 @@ void Reporter::report_state(const char *name, State &state) {
         stddev = std::sqrt(square_avg - avg * avg);
     }
 
+    // the loop's own cost per sample: the fences, the timestamps and the
+    // block_left test that comes before them
 #if __x86_64__ || _M_AMD64
 #if __GNUC__
-    const int64_t kFixedOverhead = 44;
+    const int64_t kFixedOverhead = 46;
 #else
-    const int64_t kFixedOverhead = 52;
+    const int64_t kFixedOverhead = 54;
 #endif
 #else
     const int64_t kFixedOverhead = 0;
 #endif
 
     int64_t med = find_median(records.data(), records.size());
-    med -= kFixedOverhead;
-    avg -= kFixedOverhead;
-    min -= kFixedOverhead;
-    max -= kFixedOverhead;
+    if (!state.caller_timed) {
+        med -= kFixedOverhead;
+        avg -= kFixedOverhead;
+        min -= kFixedOverhead;
+        max -= kFixedOverhead;
+    }
 
     double rate = state.items_processed ?
         (double)state.iteration_count / state.items_processed
         : 1.0;
-    write_report(name, Reporter::Row{
+    Reporter::Row row{
         med * rate, avg * rate, stddev * rate,
         min * rate, max * rate, count,
-    });
+        state.counters,
+    };
+    if (state.block_iterations) {
+        // the mean of the untimed blocks, which skip the fences that start an
+        // iteration, is on a different basis from the samples above, so it
+        // is kept apart from them
+        double block_avg = (double)state.block_time / state.block_iterations;
+        row.counters.emplace_back("block_avg", block_avg * rate);
+    }
+    return row;
 }
 
 void Reporter::run_all(Options const &options) {
     setup_affinity();
+    begin_run(options, host_info());
+    std::vector<Instance> instances;
     for (Entry const &ent: entries()) {
-        run_entry(ent, options);
+        for (Instance &inst: expand_entry(ent))
+            instances.push_back(std::move(inst));
     }
+    run_instances(instances, options);
+    if (options.cache_path) {
+        ResultCache const &cache = result_cache(options.cache_path);
+        if (cache.hits)
+            fprintf(stderr, "%zu of %zu results reused from %s, pass --force to rerun them\n",
+                    cache.hits, cache.hits + cache.misses, options.cache_path);
+    }
+}
+
+Options parse_args(int argc, char **argv) {
+    Options options;
+    options.cache_path = ".hermes_cache";
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (!strncmp(arg, "--max-time=", 11)) {
+            options.max_time = atof(arg + 11);
+        } else if (!strncmp(arg, "--cache=", 8)) {
+            options.cache_path = arg + 8;
+        } else if (!strcmp(arg, "--no-cache")) {
+            options.cache_path = nullptr;
+        } else if (!strcmp(arg, "--force")) {
+            options.force_rerun = true;
+        } else if (!strcmp(arg, "--interleave")) {
+            options.schedule = Schedule::Interleaved;
+        } else if (!strncmp(arg, "--interleave=", 13)) {
+            options.schedule = Schedule::Interleaved;
+            options.rounds = atoi(arg + 13);
+        } else if (!strcmp(arg, "--layout")) {
+            options.randomize_layout = true;
+        } else if (!strncmp(arg, "--layout=", 9)) {
+            options.randomize_layout = true;
+            options.rounds = atoi(arg + 9);
+        } else if (!strncmp(arg, "--seed=", 7)) {
+            options.seed = strtoull(arg + 7, nullptr, 0);
+        } else if (!strncmp(arg, "--sample=", 9)) {
+            options.sample_every = atoll(arg + 9);
+            if (!options.max_samples)
+                options.max_samples = 1 << 20;
+        } else if (!strcmp(arg, "--sample-random")) {
+            options.sample_random = true;
+        } else if (!strncmp(arg, "--max-samples=", 14)) {
+            options.max_samples = strtoull(arg + 14, nullptr, 0);
+        } else if (!strcmp(arg, "--isolate")) {
+            options.isolate = true;
+        } else if (!strncmp(arg, "--timeout=", 10)) {
+            options.isolate = true;
+            options.timeout = atof(arg + 10);
+        } else if (!strcmp(arg, "--energy")) {
+            options.measure_energy = true;
+        } else if (!strncmp(arg, "--energy=", 9)) {
+            options.measure_energy = true;
+            options.powercap_path = arg + 9;
+        } else {
+            fprintf(stderr, "usage: %s [options]\n"
+                    "  --max-time=SEC    time budget of each benchmark (default %g)\n"
+                    "  --cache=PATH      result cache file (default %s)\n"
+                    "  --no-cache        disable the result cache\n"
+                    "  --force           rerun all benchmarks, even if their code didn't change\n"
+                    "  --interleave[=N]  run benchmarks in N shuffled rounds (default %d)\n"
+                    "  --layout[=N]      run N rounds under random code, stack and heap layouts\n"
+                    "  --seed=N          seed of the round shuffle\n"
+                    "  --sample=K        time only every K-th iteration individually\n"
+                    "  --sample-random   sample at random gaps averaging K\n"
+                    "  --max-samples=N   halve the sample rate whenever N samples are stored\n"
+                    "  --energy[=PATH]   measure RAPL energy from powercap (default %s)\n"
+                    "  --isolate         run each round in a child process, recording crashes\n"
+                    "  --timeout=SEC     kill instances running longer than SEC, implies --isolate\n",
+                    argv[0], Options().max_time, options.cache_path ? options.cache_path : "none",
+                    Options().rounds, Options().powercap_path);
+            exit(strcmp(arg, "--help") ? 1 : 0);
+        }
+    }
+    return options;
 }
 
 void _do_not_optimize_impl(void *p) {
@@ -353,26 +1369,130 @@ const char *fit_order(double &x) {
     }
 }
 
+const char *status_name(RunStatus status) {
+    const char *names[] = {"ok", "timeout", "crashed", "failed"};
+    return names[(int)status];
+}
+
+std::string status_text(Reporter::Row const &row) {
+    switch (row.status) {
+    case RunStatus::Ok:
+        return "ok";
+    case RunStatus::Timeout:
+        return "timeout";
+    case RunStatus::Crashed:
+#if __linux__
+        return std::string("crashed, ") + strsignal(row.status_code);
+#else
+        return "crashed, signal " + std::to_string(row.status_code);
+#endif
+    case RunStatus::Failed:
+        return "failed, exit code " + std::to_string(row.status_code);
+    }
+    return "unknown";
+}
+
+// the charts are redrawn whole, at a cost growing with the rows seen so far,
+// so the copy kept for an interrupted run is refreshed at most once a second
+struct RenderThrottle {
+    std::chrono::steady_clock::time_point last{};
+
+    bool due() {
+        auto now = std::chrono::steady_clock::now();
+        if (now - last < std::chrono::seconds(1))
+            return false;
+        last = now;
+        return true;
+    }
+};
+
+std::string xml_escape(std::string const &str) {
+    std::string out;
+    for (char c: str) {
+        switch (c) {
+        case '<': out += "&lt;"; break;
+        case '>': out += "&gt;"; break;
+        case '&': out += "&amp;"; break;
+        case '"': out += "&quot;"; break;
+        default: out += c;
+        }
+    }
+    return out;
+}
+
+void write_metadata(FILE *fp, std::vector<std::pair<std::string, std::string>> const &host) {
+    if (host.empty())
+        return;
+    fprintf(fp, "<metadata>\n<host");
+    for (auto const &f: host)
+        fprintf(fp, " %s=\"%s\"", f.first.c_str(), xml_escape(f.second).c_str());
+    fprintf(fp, " />\n</metadata>\n");
+}
+
 struct ConsoleReporter : Reporter {
-    ConsoleReporter() {
-        printf("%26s %11s %11s %6s %9s\n", "name", "med", "avg", "std", "n");
-        printf("-------------------------------------------------------------------\n");
+    bool header = false;
+
+    static void print_energy(const char *name, double joules, double watts) {
+        const char *prefixes[] = {"", "m", "u", "n"};
+        int i = 0;
+        while (i < 3 && joules < 1) {
+            joules *= 1000;
+            ++i;
+        }
+        printf(" %s=%.*lf%sJ/%.1lfW", name, guess_prec(6, joules), joules, prefixes[i], watts);
+    }
+
+    void begin_run(Options const &options, HostInfo const &host) override {
+        (void)options;
+        printf("%s, %.2lf GHz ticks, %d cpus, %s\n", host.cpu.c_str(), host.tick_ghz, host.cpus, host.caches.c_str());
+        printf("governor %s, turbo %s, smt %s, thp %s, numa %s, isolated %s\n",
+               host.governor.empty() ? "?" : host.governor.c_str(), host.turbo.empty() ? "?" : host.turbo.c_str(),
+               host.smt.empty() ? "?" : host.smt.c_str(), host.thp.empty() ? "?" : host.thp.c_str(),
+               host.numa.empty() ? "?" : host.numa.c_str(), host.isolcpus.empty() ? "none" : host.isolcpus.c_str());
+        printf("%s, %s %s, host %s\n\n", host.kernel.c_str(), host.compiler.c_str(), host.flags.c_str(),
+               host.fingerprint().c_str());
     }
 
     void write_report(const char *name, Reporter::Row const &row) override {
-        printf("%26s %11.*lf %11.*lf %6.*lf %9ld\n",
+        if (!header) {
+            printf("%26s %11s %11s %6s %9s\n", "name", "med", "avg", "std", "n");
+            printf("-------------------------------------------------------------------\n");
+            header = true;
+        }
+        if (row.status != RunStatus::Ok) {
+            printf("%26s \033[31;1m%s\033[0m\n", name, status_text(row).c_str());
+            fflush(stdout);
+            return;
+        }
+        printf("%26s %11.*lf %11.*lf %6.*lf %9ld",
                name, guess_prec(11, row.med), row.med, guess_prec(11, row.avg), row.avg, guess_prec(6, row.stddev), row.stddev, row.count);
+        for (auto const &c: row.counters) {
+            double value = c.second;
+            const char *order = fit_order(value);
+            printf(" %s=%.*lf%s", c.first.c_str(), guess_prec(6, value), value, order);
+        }
+        if (!std::isnan(row.pkg_joules))
+            print_energy("pkg", row.pkg_joules, row.pkg_watts);
+        if (!std::isnan(row.dram_joules))
+            print_energy("dram", row.dram_joules, row.dram_watts);
+        if (row.cached)
+            printf(" (cached)");
+        printf("\n");
+        fflush(stdout);
     }
 };
 
 struct CSVReporter : Reporter {
     FILE *fp;
+    // the host id, then the settings that most often explain a difference
+    // between two hosts, as the last columns
+    std::string host;
 
     CSVReporter(const char *filename) {
         fp = fopen(filename, "w");
         if (!fp)
             abort();
-        fprintf(fp, "name,avg,std,min,max,n\n");
+        fprintf(fp, "name,avg,std,min,max,n,status,status_code,host,governor,turbo,smt\n");
     }
 
     CSVReporter(CSVReporter &&) = delete;
@@ -381,14 +1501,27 @@ struct CSVReporter : Reporter {
         fclose(fp);
     }
 
+    static std::string host_columns(HostInfo const &info) {
+        return info.fingerprint() + ',' + info.governor + ',' + info.turbo + ',' + info.smt;
+    }
+
+    void begin_run(Options const &options, HostInfo const &info) override {
+        (void)options;
+        host = host_columns(info);
+    }
+
     void write_report(const char *name, Reporter::Row const &row) override {
-        fprintf(fp, "%s,%lf,%lf,%lf,%lf,%ld\n",
-               name, row.avg, row.stddev, row.min, row.max, row.count);
+        if (host.empty())
+            host = host_columns(host_info());
+        fprintf(fp, "%s,%lf,%lf,%lf,%lf,%ld,%s,%d,%s\n",
+               name, row.avg, row.stddev, row.min, row.max, row.count,
+               status_name(row.status), row.status_code, host.c_str());
+        fflush(fp);
     }
 };
 
 struct SVGReporter : Reporter {
-    FILE *fp;
+    std::string path;
 
     struct Bar {
         std::string name;
@@ -402,16 +1535,29 @@ struct SVGReporter : Reporter {
     };
 
     std::vector<Bar> bars;
+    std::vector<std::pair<std::string, std::string>> host;
+    RenderThrottle throttle;
 
-    SVGReporter(const char *filename) {
-        fp = fopen(filename, "w");
+    SVGReporter(const char *filename) : path(filename) {
+        FILE *fp = fopen(filename, "w");
         if (!fp)
             abort();
+        fclose(fp);
     }
 
     SVGReporter(SVGReporter &&) = delete;
 
     ~SVGReporter() {
+        render();
+    }
+
+    // rewritten while rows arrive, so an interrupted run still has its chart,
+    // and once more at the end
+    void render() const {
+        std::string tmp = path + ".tmp";
+        FILE *fp = fopen(tmp.c_str(), "w");
+        if (!fp)
+            return;
         double w = 1920;
         double h = 1080;
         fprintf(fp, "<svg viewBox=\"0 0 %lf %lf\" xmlns=\"http://www.w3.org/2000/svg\">\n", w, h);
@@ -442,6 +1588,7 @@ struct SVGReporter : Reporter {
                     "  text-anchor: middle;\n"
                     "}\n"
                     "</style>\n");
+        write_metadata(fp, host);
         fprintf(fp, "<rect x=\"0\" y=\"0\" width=\"%lf\" height=\"%lf\" fill=\"lightgray\" />\n", w, h);
 
         double xscale = (w - 80) / (bars.size() + 1);
@@ -482,9 +1629,17 @@ struct SVGReporter : Reporter {
         }
         fprintf(fp, "</svg>\n");
         fclose(fp);
+        rename(tmp.c_str(), path.c_str());
+    }
+
+    void begin_run(Options const &options, HostInfo const &info) override {
+        (void)options;
+        host = info.fields();
     }
 
     void write_report(const char *name, Reporter::Row const &row) override {
+        if (row.status != RunStatus::Ok)
+            return;
         auto axis_scale = [] (double x) {
             if (x <= 1)
                 return x;
@@ -506,6 +1661,569 @@ struct SVGReporter : Reporter {
             stddev_up,
             stddev_down,
         });
+        if (throttle.due())
+            render();
+    }
+};
+
+struct SweepReporter : Reporter {
+    std::string path;
+    SweepMetric metric;
+
+    struct Point {
+        std::string source;
+        std::string entry;
+        std::vector<int64_t> args;
+        Reporter::Row row;
+    };
+
+    std::vector<Point> points;
+    std::vector<std::pair<std::string, std::string>> host;
+    // host ids each baseline was measured on
+    std::map<std::string, std::set<std::string>> baseline_hosts;
+    RenderThrottle throttle;
+
+    SweepReporter(const char *filename, SweepMetric metric_, std::vector<std::string> const &baselines)
+        : path(filename), metric(metric_) {
+        FILE *fp = fopen(filename, "w");
+        if (!fp)
+            abort();
+        fclose(fp);
+        for (auto const &path: baselines)
+            load_baseline(path);
+    }
+
+    SweepReporter(SweepReporter &&) = delete;
+
+    static Point parse_name(std::string source, std::string const &name, Reporter::Row const &row) {
+        Point pt{std::move(source), name, {}, row};
+        size_t pos = name.find('/');
+        if (pos != std::string::npos) {
+            pt.entry = name.substr(0, pos);
+            while (pos != std::string::npos) {
+                pt.args.push_back(parse_arg(name.c_str() + pos + 1));
+                pos = name.find('/', pos + 1);
+            }
+        }
+        return pt;
+    }
+
+    void load_baseline(std::string const &path) {
+        FILE *in = fopen(path.c_str(), "r");
+        if (!in) {
+            fprintf(stderr, "WARNING: cannot open baseline %s\n", path.c_str());
+            return;
+        }
+        std::string source = path.substr(path.rfind('/') + 1);
+        char line[1024];
+        while (fgets(line, sizeof line, in)) {
+            char name[512];
+            char status[16];
+            char host_id[64];
+            Reporter::Row row{};
+            long long count;
+            int fields = sscanf(line, "%511[^,],%lf,%lf,%lf,%lf,%lld,%15[^,],%d,%63[^,\n]", name,
+                                &row.avg, &row.stddev, &row.min, &row.max, &count, status, &row.status_code, host_id);
+            if (fields < 6)
+                continue;
+            if (fields == 9) {
+                baseline_hosts[source].insert(host_id);
+                if (strcmp(status, status_name(RunStatus::Ok)))
+                    continue;
+            }
+            row.med = row.avg;
+            row.count = count;
+            points.push_back(parse_name(source, name, row));
+        }
+        fclose(in);
+    }
+
+    void begin_run(Options const &options, HostInfo const &info) override {
+        (void)options;
+        host = info.fields();
+        std::string id = info.fingerprint();
+        std::set<std::string> sources;
+        for (auto const &pt: points)
+            sources.insert(pt.source);
+        sources.erase("");
+        for (auto const &source: sources) {
+            auto it = baseline_hosts.find(source);
+            if (it == baseline_hosts.end()) {
+                fprintf(stderr, "WARNING: baseline %s records no host, it may not be comparable\n", source.c_str());
+                continue;
+            }
+            std::set<std::string> others = it->second;
+            others.erase(id);
+            if (others.empty())
+                continue;
+            fprintf(stderr, "WARNING: not overlaying baseline %s, it was measured on host %s, incompatible with %s\n",
+                    source.c_str(), others.begin()->c_str(), id.c_str());
+            points.erase(std::remove_if(points.begin(), points.end(), [&] (Point const &pt) {
+                return pt.source == source;
+            }), points.end());
+        }
+    }
+
+    void write_report(const char *name, Reporter::Row const &row) override {
+        if (row.status != RunStatus::Ok)
+            return;
+        points.push_back(parse_name("", name, row));
+        if (throttle.due())
+            render();
+    }
+
+    void write_instance(Instance const &inst, Reporter::Row const &row) override {
+        if (row.status != RunStatus::Ok)
+            return;
+        points.push_back(Point{"", inst.entry->name, inst.args, row});
+        if (throttle.due())
+            render();
+    }
+
+    struct Sample {
+        int64_t x;
+        double mid;
+        double lo;
+        double hi;
+        double dev_lo;
+        double dev_hi;
+    };
+
+    Sample make_sample(int64_t x, Reporter::Row const &row) const {
+        if (metric == SweepMetric::Cost) {
+            return {x, row.med, row.min, row.max, row.avg - row.stddev, row.avg + row.stddev};
+        }
+        auto inv = [] (double t) {
+            return t > 0 ? 1e9 / t : 0.0;
+        };
+        return {x, inv(row.med), inv(row.max), inv(row.min), inv(row.avg + row.stddev), inv(row.avg - row.stddev)};
+    }
+
+    ~SweepReporter() {
+        render();
+    }
+
+    // rewritten while rows arrive, so an interrupted run still has its
+    // charts, and once more at the end
+    void render() {
+        std::string tmp = path + ".tmp";
+        FILE *fp = fopen(tmp.c_str(), "w");
+        if (!fp)
+            return;
+        // one chart per swept quantity and one series per source and
+        // combination of the remaining arguments.  An axis is an argument
+        // dimension of an entry; the axes at the same position of entries of
+        // the same arity whose values overlap are taken to sweep the same
+        // quantity and share a chart, so that related entries overlay, while
+        // unrelated ones, say thread counts and queue capacities, stay apart
+        std::map<std::pair<std::string, std::string>, std::vector<std::set<int64_t>>> distinct;
+        std::map<std::string, size_t> arity;
+        for (auto const &pt: points) {
+            auto &values = distinct[{pt.source, pt.entry}];
+            values.resize(std::max(values.size(), pt.args.size()));
+            for (size_t d = 0; d < pt.args.size(); d++)
+                values[d].insert(pt.args[d]);
+            arity[pt.entry] = std::max(arity[pt.entry], pt.args.size());
+        }
+        std::map<std::pair<std::string, size_t>, size_t> axis_index;
+        std::vector<std::pair<std::string, size_t>> axes;
+        std::vector<std::set<int64_t>> axis_values;
+        for (auto const &pt: points) {
+            auto const &values = distinct[{pt.source, pt.entry}];
+            for (size_t d = 0; d < pt.args.size(); d++) {
+                if (values[d].size() < 2 || pt.args[d] <= 0)
+                    continue;
+                auto it = axis_index.emplace(std::make_pair(pt.entry, d), axes.size());
+                if (it.second) {
+                    axes.emplace_back(pt.entry, d);
+                    axis_values.emplace_back();
+                }
+                axis_values[it.first->second].insert(pt.args[d]);
+            }
+        }
+        std::vector<size_t> group(axes.size());
+        for (size_t i = 0; i < axes.size(); i++)
+            group[i] = i;
+        auto find = [&] (size_t i) {
+            while (group[i] != i)
+                i = group[i] = group[group[i]];
+            return i;
+        };
+        for (size_t i = 0; i < axes.size(); i++) {
+            for (size_t j = i + 1; j < axes.size(); j++) {
+                if (axes[i].second != axes[j].second || arity[axes[i].first] != arity[axes[j].first])
+                    continue;
+                bool overlap = std::any_of(axis_values[i].begin(), axis_values[i].end(), [&] (int64_t x) {
+                    return axis_values[j].count(x) != 0;
+                });
+                if (overlap)
+                    group[find(j)] = find(i);
+            }
+        }
+
+        struct Chart {
+            std::string title;
+            size_t dim;
+            std::map<std::string, std::vector<Sample>> series;
+        };
+        std::map<size_t, Chart> charts;
+        for (size_t i = 0; i < axes.size(); i++) {
+            Chart &chart = charts[find(i)];
+            chart.title += (chart.title.empty() ? "" : ", ") + axes[i].first;
+            chart.dim = axes[i].second;
+        }
+        for (auto const &pt: points) {
+            for (size_t d = 0; d < pt.args.size(); d++) {
+                auto it = axis_index.find({pt.entry, d});
+                if (it == axis_index.end() || pt.args[d] <= 0)
+                    continue;
+                std::string label = pt.source.empty() ? pt.entry : pt.source + ": " + pt.entry;
+                for (size_t i = 0; i < pt.args.size(); i++)
+                    label += i == d ? "/*" : "/" + format_arg(pt.args[i]);
+                charts[find(it->second)].series[label].push_back(make_sample(pt.args[d], pt.row));
+            }
+        }
+
+        const char *palette[] = {"#1f77b4", "#d62728", "#2ca02c", "#ff7f0e", "#9467bd", "#8c564b", "#e377c2", "#17becf"};
+        double w = 1280;
+        double ch = 640;
+        double ml = 100, mr = 40, mt = 50, mb = 70;
+        fprintf(fp, "<svg viewBox=\"0 0 %lf %lf\" xmlns=\"http://www.w3.org/2000/svg\">\n", w, ch * std::max<size_t>(charts.size(), 1));
+        write_metadata(fp, host);
+        fprintf(fp, "<style type=\"text/css\">\n"
+                    "text {\n"
+                    "  font-family: monospace;\n"
+                    "  dominant-baseline: central;\n"
+                    "}\n"
+                    ".grid {\n"
+                    "  stroke: #cccccc;\n"
+                    "}\n"
+                    ".frame {\n"
+                    "  stroke: #000000;\n"
+                    "  fill: none;\n"
+                    "}\n"
+                    ".line {\n"
+                    "  fill: none;\n"
+                    "  stroke-width: 2;\n"
+                    "}\n"
+                    ".range {\n"
+                    "  stroke: none;\n"
+                    "  opacity: 0.15;\n"
+                    "}\n"
+                    ".stddev {\n"
+                    "  stroke: none;\n"
+                    "  opacity: 0.3;\n"
+                    "}\n"
+                    "</style>\n");
+
+        double y0 = 0;
+        for (auto &chart: charts) {
+            double xmin = INFINITY, xmax = -INFINITY, ymin = INFINITY, ymax = -INFINITY;
+            for (auto &series: chart.second.series) {
+                std::sort(series.second.begin(), series.second.end(), [] (Sample const &a, Sample const &b) {
+                    return a.x < b.x;
+                });
+                for (auto const &s: series.second) {
+                    xmin = std::min(xmin, (double)s.x);
+                    xmax = std::max(xmax, (double)s.x);
+                    for (double y: {s.mid, s.lo, s.hi, s.dev_lo, s.dev_hi}) {
+                        if (y > 0) {
+                            ymin = std::min(ymin, y);
+                            ymax = std::max(ymax, y);
+                        }
+                    }
+                }
+            }
+            if (!(ymin < ymax)) {
+                ymin = ymin < INFINITY ? ymin / 2 : 1;
+                ymax = ymin * 4;
+            }
+            if (!(xmin < xmax))
+                xmax = xmin * 2;
+            double lymin = std::floor(std::log10(ymin));
+            double lymax = std::ceil(std::log10(ymax));
+            double px0 = ml, px1 = w - mr, py0 = y0 + ch - mb, py1 = y0 + mt;
+            auto xmap = [&] (double x) {
+                return px0 + (std::log(x) - std::log(xmin)) / (std::log(xmax) - std::log(xmin)) * (px1 - px0);
+            };
+            auto ymap = [&] (double y) {
+                y = std::max(y, std::pow(10.0, lymin));
+                return py0 + (std::log10(y) - lymin) / (lymax - lymin) * (py1 - py0);
+            };
+
+            fprintf(fp, "<rect x=\"0\" y=\"%lf\" width=\"%lf\" height=\"%lf\" fill=\"#ffffff\" />\n", y0, w, ch);
+            fprintf(fp, "<text x=\"%lf\" y=\"%lf\" text-anchor=\"middle\">%s: %s by arg %zu</text>\n",
+                    w / 2, y0 + mt / 2, xml_escape(chart.second.title).c_str(),
+                    metric == SweepMetric::Cost ? "time per item" : "items per Gtick", chart.second.dim);
+            for (double ly = lymin; ly <= lymax; ly += 1) {
+                for (int m = 1; m < 10; m++) {
+                    double y = m * std::pow(10.0, ly);
+                    if (y > std::pow(10.0, lymax))
+                        break;
+                    fprintf(fp, "<line class=\"grid\" x1=\"%lf\" y1=\"%lf\" x2=\"%lf\" y2=\"%lf\" opacity=\"%s\" />\n",
+                            px0, ymap(y), px1, ymap(y), m == 1 ? "1" : "0.4");
+                    if (m == 1) {
+                        double value = y;
+                        const char *order = fit_order(value);
+                        fprintf(fp, "<text x=\"%lf\" y=\"%lf\" text-anchor=\"end\">%.*lf%s</text>\n",
+                                px0 - 8, ymap(y), guess_prec(6, value), value, order);
+                    }
+                }
+            }
+            std::set<int64_t> xs;
+            for (auto const &series: chart.second.series) {
+                for (auto const &s: series.second)
+                    xs.insert(s.x);
+            }
+            size_t stride = (xs.size() + 23) / 24;
+            size_t k = 0;
+            for (int64_t x: xs) {
+                if (k++ % stride)
+                    continue;
+                fprintf(fp, "<line class=\"grid\" x1=\"%lf\" y1=\"%lf\" x2=\"%lf\" y2=\"%lf\" />\n",
+                        xmap(x), py0, xmap(x), py1);
+                fprintf(fp, "<text x=\"%lf\" y=\"%lf\" text-anchor=\"middle\">%s</text>\n",
+                        xmap(x), py0 + 16, format_arg(x).c_str());
+            }
+            fprintf(fp, "<rect class=\"frame\" x=\"%lf\" y=\"%lf\" width=\"%lf\" height=\"%lf\" />\n",
+                    px0, py1, px1 - px0, py0 - py1);
+
+            size_t color = 0;
+            for (auto const &series: chart.second.series) {
+                const char *c = palette[color % (sizeof palette / sizeof palette[0])];
+                auto const &ss = series.second;
+                auto band = [&] (const char *cls, double Sample::*lo, double Sample::*hi) {
+                    fprintf(fp, "<polygon class=\"%s\" fill=\"%s\" points=\"", cls, c);
+                    for (auto const &s: ss)
+                        fprintf(fp, "%lf,%lf ", xmap(s.x), ymap(s.*hi));
+                    for (auto it = ss.rbegin(); it != ss.rend(); ++it)
+                        fprintf(fp, "%lf,%lf ", xmap(it->x), ymap((*it).*lo));
+                    fprintf(fp, "\" />\n");
+                };
+                band("range", &Sample::lo, &Sample::hi);
+                band("stddev", &Sample::dev_lo, &Sample::dev_hi);
+                fprintf(fp, "<polyline class=\"line\" stroke=\"%s\" points=\"", c);
+                for (auto const &s: ss)
+                    fprintf(fp, "%lf,%lf ", xmap(s.x), ymap(s.mid));
+                fprintf(fp, "\" />\n");
+                for (auto const &s: ss)
+                    fprintf(fp, "<circle cx=\"%lf\" cy=\"%lf\" r=\"3\" fill=\"%s\" />\n", xmap(s.x), ymap(s.mid), c);
+                fprintf(fp, "<rect x=\"%lf\" y=\"%lf\" width=\"16\" height=\"4\" fill=\"%s\" />\n",
+                        px0 + 12, py1 + 14 + 18 * color, c);
+                fprintf(fp, "<text x=\"%lf\" y=\"%lf\">%s</text>\n",
+                        px0 + 34, py1 + 16 + 18 * color, series.first.c_str());
+                ++color;
+            }
+            y0 += ch;
+        }
+        fprintf(fp, "</svg>\n");
+        fclose(fp);
+        rename(tmp.c_str(), path.c_str());
+    }
+};
+
+struct HistoryReporter : Reporter {
+    FILE *fp;
+    long long timestamp;
+    std::string commit;
+    std::string host;
+
+    static std::string git_commit() {
+        if (const char *env = getenv("HERMES_COMMIT"))
+            return env;
+        std::string commit;
+#if __linux__ || __APPLE__
+        FILE *pp = popen("git rev-parse --short=12 HEAD 2>/dev/null", "r");
+        if (pp) {
+            char buf[64];
+            if (fgets(buf, sizeof buf, pp))
+                commit = std::string(buf, strcspn(buf, "\n"));
+            pclose(pp);
+        }
+        if (!commit.empty()) {
+            pp = popen("git status --porcelain -uno 2>/dev/null", "r");
+            if (pp) {
+                char buf[8];
+                if (fgets(buf, sizeof buf, pp))
+                    commit += "-dirty";
+                pclose(pp);
+            }
+        }
+#endif
+        return commit.empty() ? "unknown" : commit;
+    }
+
+    HistoryReporter(const char *filename) {
+        fp = fopen(filename, "a");
+        if (!fp)
+            abort();
+        if (ftell(fp) == 0)
+            fprintf(fp, "# time\tcommit\thost\tname\tmed\tavg\tstd\tmin\tmax\tn\n");
+        timestamp = (long long)time(nullptr);
+        commit = git_commit();
+    }
+
+    HistoryReporter(HistoryReporter &&) = delete;
+
+    ~HistoryReporter() {
+        fclose(fp);
+    }
+
+    void begin_run(Options const &options, HostInfo const &info) override {
+        (void)options;
+        host = info.fingerprint();
+        fprintf(fp, "# host %s", host.c_str());
+        for (auto const &f: info.fields())
+            fprintf(fp, "\t%s=%s", f.first.c_str(), f.second.c_str());
+        fprintf(fp, "\n");
+    }
+
+    void write_report(const char *name, Reporter::Row const &row) override {
+        // a cached row was measured at an older commit, recording it again
+        // would hide the drift the history is kept for
+        if (row.status != RunStatus::Ok || row.cached)
+            return;
+        if (host.empty())
+            begin_run(Options(), host_info());
+        fprintf(fp, "%lld\t%s\t%s\t%s\t%.17g\t%.17g\t%.17g\t%.17g\t%.17g\t%lld\n",
+                timestamp, commit.c_str(), host.c_str(), name,
+                row.med, row.avg, row.stddev, row.min, row.max, (long long)row.count);
+        fflush(fp);
+    }
+};
+
+struct JSONReporter : Reporter {
+    FILE *fp;
+    bool ndjson;
+    bool started = false;
+    size_t records = 0;
+    // where the closing brackets start, overwritten by the next record
+    long tail = 0;
+
+    JSONReporter(const char *filename, bool ndjson_) : ndjson(ndjson_) {
+        fp = fopen(filename, "w");
+        if (!fp)
+            abort();
+    }
+
+    JSONReporter(JSONReporter &&) = delete;
+
+    ~JSONReporter() {
+        if (!started)
+            begin_run(Options(), host_info());
+        fclose(fp);
+    }
+
+    static std::string quote(std::string const &str) {
+        std::string out = "\"";
+        for (char c: str) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if ((unsigned char)c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof buf, "\\u%04x", c);
+                out += buf;
+            } else {
+                out += c;
+            }
+        }
+        return out + '"';
+    }
+
+    static std::string number(double x) {
+        if (!std::isfinite(x))
+            return "null";
+        char buf[32];
+        snprintf(buf, sizeof buf, "%.17g", x);
+        return buf;
+    }
+
+    // writes the record so that the file is complete JSON after every call
+    void append(std::string const &record) {
+        if (ndjson) {
+            fprintf(fp, "%s\n", record.c_str());
+        } else {
+            fseek(fp, tail, SEEK_SET);
+            fprintf(fp, "%s\n    %s", records ? "," : "", record.c_str());
+            tail = ftell(fp);
+            fprintf(fp, "\n  ]\n}\n");
+        }
+        ++records;
+        fflush(fp);
+    }
+
+    void begin_run(Options const &options, HostInfo const &host) override {
+        if (started)
+            return;
+        started = true;
+        const char *filters[] = {"none", "sigma", "mad"};
+        std::string context = "{\"host\": {\"id\": " + quote(host.fingerprint());
+        for (auto const &f: host.fields())
+            context += ", " + quote(f.first) + ": " + quote(f.second);
+        context += "}, \"options\": {";
+        context += "\"max_time\": " + number(options.max_time);
+        context += ", \"deviation_filter\": " + quote(filters[(int)options.deviation_filter]);
+        context += ", \"schedule\": " + quote(options.schedule == Schedule::Interleaved ? "interleaved" : "sequential");
+        context += ", \"rounds\": " + std::to_string(options.rounds);
+        context += ", \"seed\": " + std::to_string(options.seed);
+        context += ", \"sample_every\": " + std::to_string(options.sample_every);
+        context += std::string(", \"sample_random\": ") + (options.sample_random ? "true" : "false");
+        context += ", \"max_samples\": " + std::to_string(options.max_samples);
+        context += std::string(", \"randomize_layout\": ") + (options.randomize_layout ? "true" : "false");
+        context += std::string(", \"measure_energy\": ") + (options.measure_energy ? "true" : "false");
+        context += std::string(", \"isolate\": ") + (options.isolate ? "true" : "false");
+        context += ", \"timeout\": " + number(options.timeout);
+        context += "}, \"units\": {\"time\": \"tick\", \"energy\": \"J\", \"power\": \"W\"}}";
+        if (ndjson) {
+            fprintf(fp, "{\"type\": \"context\", \"context\": %s}\n", context.c_str());
+        } else {
+            fprintf(fp, "{\n  \"context\": %s,\n  \"benchmarks\": [", context.c_str());
+            tail = ftell(fp);
+            fprintf(fp, "\n  ]\n}\n");
+        }
+        fflush(fp);
+    }
+
+    void write_record(std::string const &name, Entry const *entry, std::vector<int64_t> const &args,
+                      Reporter::Row const &row) {
+        if (!started)
+            begin_run(Options(), host_info());
+        std::string rec = ndjson ? "{\"type\": \"benchmark\", " : "{";
+        rec += "\"name\": " + quote(name);
+        if (entry) {
+            rec += ", \"entry\": " + quote(entry->name) + ", \"args\": [";
+            for (size_t i = 0; i < args.size(); i++)
+                rec += (i ? ", " : "") + std::to_string(args[i]);
+            rec += "]";
+        }
+        rec += ", \"med\": " + number(row.med);
+        rec += ", \"avg\": " + number(row.avg);
+        rec += ", \"stddev\": " + number(row.stddev);
+        rec += ", \"min\": " + number(row.min);
+        rec += ", \"max\": " + number(row.max);
+        rec += ", \"count\": " + std::to_string(row.count);
+        rec += ", \"counters\": {";
+        for (size_t i = 0; i < row.counters.size(); i++)
+            rec += (i ? ", " : "") + quote(row.counters[i].first) + ": " + number(row.counters[i].second);
+        rec += "}";
+        rec += ", \"pkg_joules\": " + number(row.pkg_joules);
+        rec += ", \"dram_joules\": " + number(row.dram_joules);
+        rec += ", \"pkg_watts\": " + number(row.pkg_watts);
+        rec += ", \"dram_watts\": " + number(row.dram_watts);
+        rec += ", \"status\": " + quote(status_name(row.status));
+        rec += ", \"status_code\": " + std::to_string(row.status_code);
+        rec += std::string(", \"cached\": ") + (row.cached ? "true" : "false");
+        rec += "}";
+        append(rec);
+    }
+
+    void write_report(const char *name, Reporter::Row const &row) override {
+        write_record(name, nullptr, {}, row);
+    }
+
+    void write_instance(Instance const &inst, Reporter::Row const &row) override {
+        write_record(inst.name, inst.entry, inst.args, row);
     }
 };
 
@@ -530,6 +2248,18 @@ struct MultipleReporter : Reporter {
             r->write_report(name, row);
         }
     }
+
+    void write_instance(Instance const &inst, Reporter::Row const &row) override {
+        for (auto &r: reporters) {
+            r->write_instance(inst, row);
+        }
+    }
+
+    void begin_run(Options const &options, HostInfo const &host) override {
+        for (auto &r: reporters) {
+            r->begin_run(options, host);
+        }
+    }
 };
 
 }
@@ -546,6 +2276,18 @@ Reporter *makeSVGReporter(const char *path) {
     return new SVGReporter(path);
 }
 
+Reporter *makeSweepReporter(const char *path, SweepMetric metric, std::vector<std::string> const &baselines) {
+    return new SweepReporter(path, metric, baselines);
+}
+
+Reporter *makeHistoryReporter(const char *path) {
+    return new HistoryReporter(path);
+}
+
+Reporter *makeJSONReporter(const char *path, bool ndjson) {
+    return new JSONReporter(path, ndjson);
+}
+
 Reporter *makeNullReporter() {
     return new NullReporter();
 }
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <cmath>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <string>
 #include <vector>
 #if __x86_64__ || __amd64__
 #include <x86intrin.h>
@@ -43,6 +45,14 @@ namespace hermes {
 #define HERMES_NOINLINE
 #define HERMES_RESTRICT
 #endif
+#if defined(__has_attribute)
+#if __has_attribute(__patchable_function_entry__)
+#define HERMES_LAYOUT(pad) __attribute__((__aligned__(64), __patchable_function_entry__(pad, 0)))
+#endif
+#endif
+#ifndef HERMES_LAYOUT
+#define HERMES_LAYOUT(pad)
+#endif
 
 HERMES_ALWAYS_INLINE HERMES_OPTIMIZE inline void mfence() {
 #if __x86_64__ || __amd64__ || _M_AMD64 || _M_IX86
@@ -107,11 +117,55 @@ enum class DeviationFilter {
     MAD,
 };
 
+enum class Schedule {
+    Sequential,
+    Interleaved,
+};
+
 struct Options {
     double max_time = 0.5;
     DeviationFilter deviation_filter = DeviationFilter::MAD;
+    // results of unchanged benchmarks are reused from this file, nullptr disables
+    const char *cache_path = nullptr;
+    // ignore cached results, rerun everything and refresh the cache
+    bool force_rerun = false;
+    // interleaved runs each instance in several short rounds, shuffled with
+    // the other instances, so that slow drift is spread evenly over all
+    Schedule schedule = Schedule::Sequential;
+    int rounds = 8;
+    // seed of the round shuffle, 0 picks a random one
+    uint64_t seed = 0;
+    // only every sample_every-th iteration is timed on its own and stored,
+    // the ones in between are timed in aggregate and reported as the
+    // block_avg counter; 1 times all of them
+    int64_t sample_every = 1;
+    // sample at random gaps averaging sample_every, to avoid aliasing with
+    // periodic behaviour of the workload
+    bool sample_random = false;
+    // bound on stored samples, when reached every other one is dropped and
+    // the sample rate halved; 0 is unbounded.  Samples are stored in chunks
+    // of 65536, so within a trial the bound is checked a chunk at a time and
+    // one below 65536 acts as 65536; the rounds merged under randomize_layout
+    // or isolate are cut down to the exact bound
+    size_t max_samples = 0;
+    // run every instance in `rounds` rounds, each under a random code copy,
+    // stack offset and hermes::alloc offset, and report the variance due to
+    // layout apart from measurement noise
+    bool randomize_layout = false;
+    // read the RAPL package and DRAM energy counters under powercap_path
+    // around every round, see Reporter::Row
+    bool measure_energy = false;
+    const char *powercap_path = "/sys/class/powercap";
+    // run every round in a forked child, so that a crash or hang is recorded
+    // as a failed row and the rest of the suite still runs
+    bool isolate = false;
+    // wall clock limit of one isolated instance over all its rounds, in
+    // seconds, 0 for none
+    double timeout = 0;
 };
 
+Options parse_args(int argc, char **argv);
+
 struct State {
 private:
     friend struct Reporter;
@@ -133,6 +187,38 @@ private:
     size_t nargs = 0;
     int64_t items_processed = 0;
     DeviationFilter deviation_filter = DeviationFilter::None;
+    std::vector<std::pair<std::string, double>> counters;
+    size_t nchunks = 1;
+    int64_t sample_every = 1;
+    bool sample_random = false;
+    size_t max_samples = 0;
+    uint64_t sample_rng = 0;
+    // untimed iterations left in the current aggregate block
+    int64_t block_left = 0;
+    int64_t block_size = 0;
+    int64_t block_t0 = 0;
+    int64_t block_iterations = 0;
+    int64_t block_time = 0;
+    // samples came from record() rather than the timed loop
+    bool caller_timed = false;
+    bool skipped = false;
+
+    void grow();
+    void decimate();
+    void begin_block();
+
+    HERMES_ALWAYS_INLINE HERMES_OPTIMIZE void push(int64_t dt) {
+        auto &chunk = *rec_chunks_tail;
+        chunk.records[chunk.count++] = dt;
+        if (chunk.count == chunk.kMaxPerChunk)
+            grow();
+        ++iteration_count;
+    }
+
+    void merge(State &other);
+    // the measurements, passed from an isolated child back to the supervisor
+    std::string serialize() const;
+    bool deserialize(std::string const &data);
 
 public:
     HERMES_ALWAYS_INLINE HERMES_OPTIMIZE int64_t arg(size_t i) const {
@@ -144,6 +230,10 @@ public:
     State(Options const &options) {
         set_max_time(options.max_time);
         set_deviation_filter(options.deviation_filter);
+        sample_every = options.sample_every > 1 ? options.sample_every : 1;
+        sample_random = options.sample_random && sample_every > 1;
+        max_samples = options.max_samples;
+        sample_rng = (uint64_t)now() | 1;
     }
 
     ~State() {
@@ -170,10 +260,30 @@ public:
         }
 
         HERMES_ALWAYS_INLINE HERMES_OPTIMIZE iterator &operator++() {
+            // the block test comes before the fenced timestamp, so a block
+            // pays for one timestamp, not one per iteration; on the
+            // individually timed path its cost is part of kFixedOverhead
+#if __GNUC__
+            if (__builtin_expect(state.block_left != 0, 0)) {
+#else
+            if (state.block_left != 0) {
+#endif
+                if (--state.block_left)
+                    return *this;
+                state.end_block();
+                ok = state.next();
+                if (ok)
+                    state.start();
+                return *this;
+            }
             state.stop();
             ok = state.next();
-            if (ok)
-                state.start();
+            if (ok) {
+                if (state.sample_every > 1)
+                    state.begin_block();
+                else
+                    state.start();
+            }
             return *this;
         }
 
@@ -217,6 +327,7 @@ public:
     HERMES_ALWAYS_INLINE HERMES_OPTIMIZE void resume() {
         int64_t t1 = now();
         t0 -= t1 - pause_t0;
+        block_t0 -= t1 - pause_t0;
     }
 
     HERMES_ALWAYS_INLINE HERMES_OPTIMIZE void stop() {
@@ -231,14 +342,24 @@ public:
     HERMES_ALWAYS_INLINE HERMES_OPTIMIZE void stop(int64_t t) {
         int64_t dt = t - t0;
         time_elapsed += dt;
-        auto &chunk = *rec_chunks_tail;
-        chunk.records[chunk.count++] = dt;
-        if (chunk.count == chunk.kMaxPerChunk) {
-            Chunk *new_node = new Chunk();
-            rec_chunks_tail->next = new_node;
-            rec_chunks_tail = new_node;
-        }
-        ++iteration_count;
+        push(dt);
+    }
+
+    // records one iteration timed by the caller, without charging it to the
+    // time budget, for workloads where many operations overlap; such samples
+    // don't carry the loop's fence overhead, summarize leaves them as they are
+    HERMES_ALWAYS_INLINE HERMES_OPTIMIZE void record(int64_t dt) {
+        caller_timed = true;
+        push(dt);
+    }
+
+    HERMES_ALWAYS_INLINE HERMES_OPTIMIZE void end_block() {
+        mfence();
+        int64_t dt = now() - block_t0;
+        block_time += dt;
+        time_elapsed += dt;
+        block_iterations += block_size;
+        iteration_count += block_size;
     }
 
     HERMES_ALWAYS_INLINE HERMES_OPTIMIZE bool next() {
@@ -258,6 +379,20 @@ public:
         return time_elapsed;
     }
 
+    int64_t time_left() const noexcept {
+        return max_time - time_elapsed;
+    }
+
+    // marks this instance as meaningless, say a cpu paired with itself, so
+    // that it's left out of the reports; call it instead of the timed loop
+    void skip() noexcept {
+        skipped = true;
+    }
+
+    void add_time(int64_t dt) noexcept {
+        time_elapsed += dt;
+    }
+
     void set_max_time(double t) {
         max_time = (int64_t)(t * 1000000000);
     }
@@ -269,6 +404,17 @@ public:
     void set_items_processed(int64_t num) {
         items_processed = num;
     }
+
+    // extra named value reported next to the timing statistics
+    void set_counter(const char *name, double value) {
+        for (auto &c: counters) {
+            if (c.first == name) {
+                c.second = value;
+                return;
+            }
+        }
+        counters.emplace_back(name, value);
+    }
 };
 
 struct Entry {
@@ -278,6 +424,53 @@ struct Entry {
 };
 
 int register_entry(Entry ent);
+// copies of func's code placed at different alignments, see BENCHMARK
+int register_layouts(void (*func)(State &), std::vector<void (*)(State &)> variants);
+
+// one expanded argument tuple of an entry, e.g. BM_memcpy/64k
+struct Instance {
+    Entry const *entry;
+    std::string name;
+    std::vector<int64_t> args;
+};
+
+// the machine and run conditions results were measured under, captured
+// once per process by host_info, after run_all has pinned the thread
+struct HostInfo {
+    std::string cpu;
+    std::string microcode;
+    // ticks of now() per nanosecond, measured against the steady clock
+    double tick_ghz = 0;
+    std::string governor;
+    std::string turbo;
+    std::string smt;
+    int cpus = 0;
+    std::string caches;
+    std::string numa;
+    std::string kernel;
+    std::string thp;
+    std::string compiler;
+    std::string flags;
+    std::string isolcpus;
+
+    std::vector<std::pair<std::string, std::string>> fields() const;
+    // hash of the decisive fields, equal ids mean comparable results
+    std::string fingerprint() const;
+    // whether a difference in this field makes results incomparable
+    static bool decisive(std::string const &field);
+};
+
+HostInfo const &host_info();
+
+enum class RunStatus {
+    Ok,
+    // killed by the supervisor after Options::timeout
+    Timeout,
+    // killed by a signal, Row::status_code is its number
+    Crashed,
+    // exited on its own, Row::status_code is the exit code
+    Failed,
+};
 
 struct Reporter {
     struct Row {
@@ -287,13 +480,34 @@ struct Reporter {
         double min;
         double max;
         int64_t count;
+        std::vector<std::pair<std::string, double>> counters{};
+        // energy in joules per iteration, or per item when items are set,
+        // and average power in watts over the whole benchmark including its
+        // setup, NaN without Options::measure_energy or readable counters
+        double pkg_joules = NAN;
+        double dram_joules = NAN;
+        double pkg_watts = NAN;
+        double dram_watts = NAN;
+        // anything but Ok leaves the statistics above NaN and count 0
+        RunStatus status = RunStatus::Ok;
+        int status_code = 0;
+        // reused from the result cache instead of measured by this run
+        bool cached = false;
     };
 
     void run_entry(Entry const &ent, Options const &options = {});
     void run_all(Options const &options = {});
+    void run_instances(std::vector<Instance> const &instances, Options const &options = {});
+
+    static Row summarize(State &state);
 
+    // called by run_all before the first row, with the options and the host
+    // the rows come from
+    virtual void begin_run(Options const &options, HostInfo const &host);
     virtual void report_state(const char *name, State &state);
     virtual void write_report(const char *name, Row const &row) = 0;
+    // same as write_report, for reporters that need the entry and argument values
+    virtual void write_instance(Instance const &inst, Row const &row);
 
     virtual ~Reporter() = default;
 };
@@ -301,6 +515,23 @@ struct Reporter {
 Reporter *makeConsoleReporter();
 Reporter *makeCSVReporter(const char *path);
 Reporter *makeSVGReporter(const char *path);
+
+enum class SweepMetric {
+    Cost,
+    Throughput,
+};
+
+// plots each entry against its varying arguments on log-log axes, rows from
+// the CSV files in baselines are overlaid for comparison
+Reporter *makeSweepReporter(const char *path, SweepMetric metric = SweepMetric::Cost,
+                            std::vector<std::string> const &baselines = {});
+// appends every row to an append-only history file, keyed by git commit,
+// host fingerprint and time, see hermes_history for querying it
+Reporter *makeHistoryReporter(const char *path);
+// one record per instance with the full row, its numeric arguments, the
+// options and the host; flushed after every record so that a killed run
+// still leaves valid output, ndjson writes one object per line instead
+Reporter *makeJSONReporter(const char *path, bool ndjson = false);
 Reporter *makeNullReporter();
 Reporter *makeMultipleReporter(std::vector<Reporter *> const &reporters);
 
@@ -317,12 +548,96 @@ HERMES_OPTIMIZE void do_not_optimize(T &&t) {
 
 #define BENCHMARK_DEFINE(name) \
 static int _defbench_##name = ::hermes::register_entry({name, #name});
+// the body is inlined into one wrapper per padding, for Options::randomize_layout;
+// the loops stay 16 byte aligned, so the pads are picked to put them at each of
+// the four offsets in a 64 byte line.  They are literals since GCC drops the
+// layout attributes when the pad is a template argument
 #define BENCHMARK(name, ...) \
 extern "C" void name(::hermes::State &); \
+static void name##_layout16(::hermes::State &); \
+static void name##_layout36(::hermes::State &); \
+static void name##_layout52(::hermes::State &); \
+static HERMES_ALWAYS_INLINE inline void name##_body(::hermes::State &); \
 static int _defbench_##name = ::hermes::register_entry({name, #name, __VA_ARGS__}); \
-extern "C" HERMES_NOINLINE void name(::hermes::State &h)
+static int _deflayout_##name = ::hermes::register_layouts(name, \
+    {name, name##_layout16, name##_layout36, name##_layout52}); \
+extern "C" HERMES_NOINLINE HERMES_LAYOUT(0) void name(::hermes::State &h) { \
+    name##_body(h); \
+} \
+static HERMES_NOINLINE HERMES_LAYOUT(16) void name##_layout16(::hermes::State &h) { \
+    name##_body(h); \
+} \
+static HERMES_NOINLINE HERMES_LAYOUT(36) void name##_layout36(::hermes::State &h) { \
+    name##_body(h); \
+} \
+static HERMES_NOINLINE HERMES_LAYOUT(52) void name##_layout52(::hermes::State &h) { \
+    name##_body(h); \
+} \
+static HERMES_ALWAYS_INLINE inline void name##_body(::hermes::State &h)
 
 std::vector<int64_t> linear_range(int64_t begin, int64_t end, int64_t step = 1);
 std::vector<int64_t> log_range(int64_t begin, int64_t end, double factor = 2);
 
+enum class NumaPlacement {
+    Default,
+    Local,
+    Remote,
+    Interleave,
+    Distance,
+};
+
+struct AllocOptions {
+    // 0 for the system default, otherwise 4096, 2M or 1G
+    size_t page_size = 0;
+    NumaPlacement placement = NumaPlacement::Default;
+    // for NumaPlacement::Distance, as listed in /sys/devices/system/node/node*/distance
+    int64_t node_distance = 10;
+    size_t alignment = 64;
+    // the buffer starts this many bytes past an aligned address
+    size_t offset = 0;
+    bool prefault = true;
+    bool lock = true;
+};
+
+// nullptr when the memory or the page size cannot be had, as with no 1G
+// hugetlb pages reserved; the benchmark should skip() rather than measure
+// another page size
+void *alloc(size_t size, AllocOptions const &options = {});
+void dealloc(void *ptr);
+// nonzero seeds a random offset added to every following alloc, a multiple
+// of AllocOptions::alignment below 4096
+void _set_alloc_jitter(uint64_t seed);
+
+// deterministic benchmark inputs: the same arguments and seed give the same
+// data on every run, and each pool is generated once per process and shared
+// by all benchmarks and argument tuples asking for it
+namespace data {
+
+// uniform in [lo, hi]
+std::vector<int64_t> const &uniform(size_t n, int64_t lo, int64_t hi, uint64_t seed = 0);
+std::vector<int64_t> const &normal(size_t n, double mean, double stddev, uint64_t seed = 0);
+// ranks in [1, nitems], rank k drawn with probability proportional to 1 / k^s
+std::vector<int64_t> const &zipf(size_t n, int64_t nitems, double s = 1.0, uint64_t seed = 0);
+// strictly increasing with random gaps
+std::vector<int64_t> const &sorted(size_t n, uint64_t seed = 0);
+// sorted, then swap_fraction * n elements swapped with a near neighbour
+std::vector<int64_t> const &nearly_sorted(size_t n, double swap_fraction, uint64_t seed = 0);
+// random permutation of [0, n)
+std::vector<int64_t> const &permutation(size_t n, uint64_t seed = 0);
+// next[i] links all of [0, n) into a single random cycle, for pointer chasing
+std::vector<int64_t> const &pointer_chase(size_t n, uint64_t seed = 0);
+// alphanumeric strings with lengths uniform in [min_len, max_len]
+std::vector<std::string> const &strings(size_t n, size_t min_len, size_t max_len, uint64_t seed = 0);
+
+// frees all pools, references returned before become dangling
+void clear_pools();
+
+}
+
+// sweep dimensions for benchmarks taking AllocOptions::page_size and
+// AllocOptions::node_distance as arguments; only the huge page sizes with
+// reserved hugetlb pages, or 2M with transparent huge pages, are listed
+std::vector<int64_t> page_size_range();
+std::vector<int64_t> node_distance_range();
+
 }
@@ -0,0 +1,332 @@
+#include "hermes.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#if __linux__
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace hermes {
+
+namespace {
+
+#if __linux__
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+// from linux/mempolicy.h, not every libc ships numaif.h
+const int kMpolPreferred = 1;
+const int kMpolBind = 2;
+const int kMpolInterleave = 3;
+#endif
+
+const size_t k2M = 2 * 1024 * 1024;
+const size_t k1G = 1024 * 1024 * 1024;
+
+struct Mapping {
+    void *base;
+    size_t length;
+    bool mapped;
+};
+
+std::mutex &mappings_mutex() {
+    static std::mutex instance;
+    return instance;
+}
+
+std::map<void *, Mapping> &mappings() {
+    static std::map<void *, Mapping> instance;
+    return instance;
+}
+
+uint64_t &jitter_rng() {
+    static uint64_t instance = 0;
+    return instance;
+}
+
+void warn_once(bool &warned, const char *msg) {
+    if (!warned) {
+        fprintf(stderr, "\033[33;1mWARNING: %s\n\033[0m", msg);
+        warned = true;
+    }
+}
+
+#if __linux__
+bool thp_enabled() {
+    FILE *fp = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    bool thp = false;
+    if (fp) {
+        char buf[128] = {};
+        fgets(buf, sizeof buf, fp);
+        thp = !strstr(buf, "[never]");
+        fclose(fp);
+    }
+    return thp;
+}
+
+// hugetlb pages reserved for the size, 0 when there is no pool
+long long hugetlb_pages(size_t page) {
+    std::string path = "/sys/kernel/mm/hugepages/hugepages-" + std::to_string(page / 1024) + "kB/nr_hugepages";
+    FILE *fp = fopen(path.c_str(), "r");
+    long long n = 0;
+    if (fp) {
+        if (fscanf(fp, "%lld", &n) != 1)
+            n = 0;
+        fclose(fp);
+    }
+    return n;
+}
+#endif
+
+#if __linux__
+std::vector<int> online_nodes() {
+    std::vector<int> nodes;
+    FILE *fp = fopen("/sys/devices/system/node/online", "r");
+    if (fp) {
+        int lo, hi;
+        while (fscanf(fp, "%d", &lo) == 1) {
+            hi = lo;
+            int c = fgetc(fp);
+            if (c == '-') {
+                if (fscanf(fp, "%d", &hi) != 1)
+                    break;
+                c = fgetc(fp);
+            }
+            for (int n = lo; n <= hi; n++)
+                nodes.push_back(n);
+            if (c != ',')
+                break;
+        }
+        fclose(fp);
+    }
+    if (nodes.empty())
+        nodes.push_back(0);
+    return nodes;
+}
+
+int local_node() {
+    unsigned int cpu = 0, node = 0;
+    getcpu(&cpu, &node);
+    return (int)node;
+}
+
+// distances from node to every online node, indexed by node id
+std::vector<int64_t> node_distances(int node) {
+    std::vector<int64_t> distances;
+    std::string path = "/sys/devices/system/node/node" + std::to_string(node) + "/distance";
+    FILE *fp = fopen(path.c_str(), "r");
+    if (fp) {
+        long long d;
+        while (fscanf(fp, "%lld", &d) == 1)
+            distances.push_back(d);
+        fclose(fp);
+    }
+    return distances;
+}
+
+bool bind_numa(void *base, size_t length, AllocOptions const &options) {
+    int mode = kMpolBind;
+    unsigned long mask[16]{};
+    const unsigned long kMaxNode = sizeof mask * 8;
+    auto set_node = [&] (int n) {
+        if (n >= 0 && (unsigned long)n < kMaxNode)
+            mask[n / (sizeof mask[0] * 8)] |= 1ul << (n % (sizeof mask[0] * 8));
+    };
+
+    int local = local_node();
+    switch (options.placement) {
+    case NumaPlacement::Default:
+        return true;
+    case NumaPlacement::Local:
+        mode = kMpolPreferred;
+        set_node(local);
+        break;
+    case NumaPlacement::Interleave:
+        mode = kMpolInterleave;
+        for (int n: online_nodes())
+            set_node(n);
+        break;
+    case NumaPlacement::Remote:
+    case NumaPlacement::Distance:
+        {
+            // the distance file lists one entry per online node
+            auto nodes = online_nodes();
+            auto distances = node_distances(local);
+            int best = -1;
+            for (size_t i = 0; i < distances.size() && i < nodes.size(); i++) {
+                if (options.placement == NumaPlacement::Remote) {
+                    if (best == -1 || distances[i] > distances[best])
+                        best = (int)i;
+                } else if (distances[i] == options.node_distance) {
+                    best = (int)i;
+                    break;
+                }
+            }
+            if (best == -1)
+                return false;
+            if (nodes[best] == local && options.placement == NumaPlacement::Remote) {
+                static bool warned = false;
+                warn_once(warned, "no remote NUMA node, allocating on the local node");
+            }
+            set_node(nodes[best]);
+        }
+        break;
+    }
+    return syscall(SYS_mbind, base, length, mode, mask, kMaxNode, 0) == 0;
+}
+#endif
+
+}
+
+void _set_alloc_jitter(uint64_t seed) {
+    std::lock_guard<std::mutex> guard(mappings_mutex());
+    jitter_rng() = seed;
+}
+
+void *alloc(size_t size, AllocOptions const &options_) {
+    AllocOptions options = options_;
+    {
+        std::lock_guard<std::mutex> guard(mappings_mutex());
+        uint64_t &rng = jitter_rng();
+        if (rng) {
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            // whole multiples of the alignment, which callers rely on
+            size_t step = std::max<size_t>(options.alignment, 1);
+            size_t steps = std::max<size_t>(4096 / step, 1);
+            options.offset += step * (rng % steps);
+        }
+    }
+    const size_t kSmallPage = 4096;
+    size_t page = options.page_size ? options.page_size : kSmallPage;
+    size_t alignment = std::max<size_t>(options.alignment, options.page_size ? page : 1);
+    size_t length = (options.offset + size + page - 1) / page * page;
+    Mapping mapping{nullptr, 0, true};
+
+#if __linux__
+    void *base = MAP_FAILED;
+    if (page == k2M || page == k1G) {
+        mapping.length = length + (alignment > page ? alignment : 0);
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (page == k1G ? MAP_HUGE_1GB : MAP_HUGE_2MB);
+        base = mmap(nullptr, mapping.length, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (base == MAP_FAILED) {
+            // transparent huge pages only come in 2M, any other fallback
+            // would silently measure a different page size
+            if (page == k1G || !thp_enabled()) {
+                static bool warned = false;
+                warn_once(warned, "not enough hugetlb pages reserved for the page size\n"
+                          "echo <count> | sudo tee /sys/kernel/mm/hugepages/hugepages-<size>kB/nr_hugepages to reserve some");
+                return nullptr;
+            }
+            static bool warned = false;
+            warn_once(warned, "no 2M hugetlb pages reserved, falling back to transparent huge pages\n"
+                      "sudo sysctl vm.nr_hugepages=<count> to reserve some");
+        }
+    }
+    if (base == MAP_FAILED) {
+        mapping.length = length + (alignment > kSmallPage ? alignment : 0);
+        base = mmap(nullptr, mapping.length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED)
+            return nullptr;
+        if (page >= k2M)
+            madvise(base, mapping.length, MADV_HUGEPAGE);
+        else if (options.page_size)
+            madvise(base, mapping.length, MADV_NOHUGEPAGE);
+    }
+    mapping.base = base;
+    if (!bind_numa(base, mapping.length, options)) {
+        static bool warned = false;
+        warn_once(warned, "cannot apply NUMA placement, using the default policy");
+    }
+#else
+    mapping.length = length + alignment;
+    mapping.base = malloc(mapping.length);
+    mapping.mapped = false;
+    if (!mapping.base)
+        return nullptr;
+#endif
+
+    uintptr_t start = ((uintptr_t)mapping.base + alignment - 1) / alignment * alignment;
+    char *ptr = (char *)start + options.offset;
+
+    if (options.prefault) {
+        // first touch, so that pages land where the policy says before timing
+        for (size_t i = 0; i < size; i += 4096)
+            ((volatile char *)ptr)[i] = 0;
+        if (size)
+            ((volatile char *)ptr)[size - 1] = 0;
+    }
+#if __linux__
+    if (options.lock && mlock(mapping.base, mapping.length)) {
+        static bool warned = false;
+        warn_once(warned, "cannot mlock benchmark buffers, raise it with: ulimit -l unlimited");
+    }
+#endif
+
+    std::lock_guard<std::mutex> guard(mappings_mutex());
+    mappings()[ptr] = mapping;
+    return ptr;
+}
+
+void dealloc(void *ptr) {
+    if (!ptr)
+        return;
+    Mapping mapping;
+    {
+        std::lock_guard<std::mutex> guard(mappings_mutex());
+        auto it = mappings().find(ptr);
+        if (it == mappings().end())
+            abort();
+        mapping = it->second;
+        mappings().erase(it);
+    }
+#if __linux__
+    if (mapping.mapped) {
+        munmap(mapping.base, mapping.length);
+        return;
+    }
+#endif
+    free(mapping.base);
+}
+
+std::vector<int64_t> page_size_range() {
+    std::vector<int64_t> sizes{4096};
+#if __linux__
+    if (thp_enabled() || hugetlb_pages(k2M) > 0)
+        sizes.push_back(k2M);
+    if (hugetlb_pages(k1G) > 0)
+        sizes.push_back(k1G);
+#endif
+    return sizes;
+}
+
+std::vector<int64_t> node_distance_range() {
+    std::vector<int64_t> distances;
+#if __linux__
+    distances = node_distances(local_node());
+    std::sort(distances.begin(), distances.end());
+    distances.erase(std::unique(distances.begin(), distances.end()), distances.end());
+#endif
+    if (distances.empty())
+        distances.push_back(10);
+    return distances;
+}
+
+}
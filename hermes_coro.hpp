@@ -0,0 +1,278 @@
+#pragma once
+
+#include "hermes.hpp"
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace hermes {
+
+namespace coro {
+
+// minimal single threaded event loop, busy polling its timers since the
+// thread is pinned to a cpu for benchmarking anyway
+struct EventLoop {
+private:
+    struct Timer {
+        int64_t deadline;
+        uint64_t seq;
+        std::coroutine_handle<> handle;
+
+        bool operator>(Timer const &that) const noexcept {
+            return deadline != that.deadline ? deadline > that.deadline : seq > that.seq;
+        }
+    };
+
+    std::deque<std::coroutine_handle<>> ready;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    uint64_t timer_seq = 0;
+    int64_t resumed = 0;
+
+    static EventLoop *&current_ptr() noexcept {
+        thread_local EventLoop *instance = nullptr;
+        return instance;
+    }
+
+public:
+    static EventLoop &current() noexcept {
+        return *current_ptr();
+    }
+
+    void post(std::coroutine_handle<> handle) {
+        ready.push_back(handle);
+    }
+
+    void post_at(int64_t deadline, std::coroutine_handle<> handle) {
+        timers.push(Timer{deadline, timer_seq++, handle});
+    }
+
+    // number of coroutine resumptions since the loop was created
+    int64_t resumptions() const noexcept {
+        return resumed;
+    }
+
+    void run() {
+        EventLoop *saved = current_ptr();
+        current_ptr() = this;
+        while (!ready.empty() || !timers.empty()) {
+            if (ready.empty()) {
+                int64_t t = now();
+                while (!timers.empty() && timers.top().deadline <= t) {
+                    ready.push_back(timers.top().handle);
+                    timers.pop();
+                }
+                continue;
+            }
+            auto handle = ready.front();
+            ready.pop_front();
+            ++resumed;
+            handle.resume();
+        }
+        current_ptr() = saved;
+    }
+};
+
+// reschedules the awaiting coroutine behind everything already ready
+struct YieldAwaitable {
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) const {
+        EventLoop::current().post(handle);
+    }
+
+    void await_resume() const noexcept {
+    }
+};
+
+inline YieldAwaitable yield() {
+    return {};
+}
+
+struct SleepAwaitable {
+    int64_t ticks;
+
+    bool await_ready() const noexcept {
+        return ticks <= 0;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) const {
+        EventLoop::current().post_at(now() + ticks, handle);
+    }
+
+    void await_resume() const noexcept {
+    }
+};
+
+inline SleepAwaitable sleep_for(int64_t ticks) {
+    return {ticks};
+}
+
+template <class T = void>
+struct Task;
+
+namespace detail {
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation = nullptr;
+
+    std::suspend_always initial_suspend() noexcept {
+        return {};
+    }
+
+    struct FinalAwaitable {
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        template <class Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            auto continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {
+        }
+    };
+
+    FinalAwaitable final_suspend() noexcept {
+        return {};
+    }
+
+    void unhandled_exception() noexcept {
+        std::terminate();
+    }
+};
+
+template <class T>
+struct Promise : PromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object() noexcept;
+
+    template <class U>
+    void return_value(U &&u) {
+        value.emplace(std::forward<U>(u));
+    }
+
+    T take() {
+        return std::move(*value);
+    }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    Task<void> get_return_object() noexcept;
+
+    void return_void() noexcept {
+    }
+
+    void take() noexcept {
+    }
+};
+
+}
+
+// lazily started coroutine, resuming its awaiter on completion
+template <class T>
+struct [[nodiscard]] Task {
+    using promise_type = detail::Promise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> handle_) noexcept : handle(handle_) {
+    }
+
+    Task(Task &&that) noexcept : handle(std::exchange(that.handle, nullptr)) {
+    }
+
+    Task &operator=(Task &&that) noexcept {
+        std::swap(handle, that.handle);
+        return *this;
+    }
+
+    ~Task() {
+        if (handle)
+            handle.destroy();
+    }
+
+    bool done() const noexcept {
+        return !handle || handle.done();
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+        handle.promise().continuation = awaiter;
+        return handle;
+    }
+
+    T await_resume() {
+        return handle.promise().take();
+    }
+
+    // starts the task on an event loop without awaiting it
+    void spawn(EventLoop &loop) {
+        loop.post(handle);
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+template <class T>
+Task<T> detail::Promise<T>::get_return_object() noexcept {
+    return Task<T>{std::coroutine_handle<Promise<T>>::from_promise(*this)};
+}
+
+inline Task<void> detail::Promise<void>::get_return_object() noexcept {
+    return Task<void>{std::coroutine_handle<Promise<void>>::from_promise(*this)};
+}
+
+namespace detail {
+
+template <class F>
+Task<void> worker(State &state, F &make_op, int64_t t_start, int64_t budget, bool &done) {
+    while (!done) {
+        int64_t t0 = now();
+        co_await make_op();
+        int64_t t1 = now();
+        state.record(t1 - t0);
+        if (t1 - t_start >= budget)
+            done = true;
+    }
+}
+
+}
+
+// keeps depth operations from make_op() in flight on a fresh event loop
+// until the time budget runs out, recording the latency of each one; the
+// completion rate of the whole loop is reported as a counter
+template <class F>
+void run(State &state, size_t depth, F make_op) {
+    EventLoop loop;
+    bool done = false;
+    int64_t ops0 = state.iterations();
+    int64_t t_start = now();
+    int64_t budget = std::max<int64_t>(state.time_left(), 1);
+    std::vector<Task<void>> workers;
+    for (size_t i = 0; i < std::max<size_t>(depth, 1); i++) {
+        workers.push_back(detail::worker(state, make_op, t_start, budget, done));
+        workers.back().spawn(loop);
+    }
+    loop.run();
+    int64_t wall = now() - t_start;
+    state.add_time(wall);
+    state.set_counter("ops_per_Gtick", (state.iterations() - ops0) * 1e9 / wall);
+}
+
+}
+
+}
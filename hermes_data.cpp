@@ -0,0 +1,317 @@
+#include "hermes.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hermes {
+
+namespace data {
+
+namespace {
+
+// counter based generator: element i only depends on seed and i, so any
+// slice of a pool can be generated independently by any thread
+HERMES_ALWAYS_INLINE inline uint64_t mix(uint64_t seed, uint64_t i) {
+    uint64_t z = seed + (i + 1) * 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+HERMES_ALWAYS_INLINE inline double unit(uint64_t x) {
+    return ((x >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+// x mapped onto [0, range) without modulo bias worth speaking of
+// a range of 0 stands for all 2^64 values, which don't fit a uint64_t
+HERMES_ALWAYS_INLINE inline uint64_t bounded(uint64_t x, uint64_t range) {
+#if __SIZEOF_INT128__
+    if (!range)
+        return x;
+    return (uint64_t)(((unsigned __int128)x * range) >> 64);
+#else
+    return range ? x % range : x;
+#endif
+}
+
+// distinct streams for the different generators sharing a seed
+enum Stream : uint64_t {
+    kUniform = 1,
+    kNormal,
+    kZipf,
+    kSorted,
+    kNearlySorted,
+    kPermutation,
+    kPointerChase,
+    kStrings,
+};
+
+uint64_t stream_seed(uint64_t seed, Stream stream) {
+    return mix(seed, stream);
+}
+
+template <class F>
+void parallel_for(size_t n, F f) {
+    const size_t kMinPerThread = 1 << 16;
+    size_t nthreads = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u),
+                                       (n + kMinPerThread - 1) / kMinPerThread);
+    if (nthreads <= 1) {
+        f(0, n);
+        return;
+    }
+    std::vector<std::thread> threads;
+    size_t per_thread = (n + nthreads - 1) / nthreads;
+    for (size_t t = 0; t < nthreads; t++) {
+        size_t begin = t * per_thread;
+        size_t end = std::min(n, begin + per_thread);
+        threads.emplace_back([&f, begin, end] {
+            f(begin, end);
+        });
+    }
+    for (auto &t: threads)
+        t.join();
+}
+
+std::mutex &pools_mutex() {
+    static std::mutex instance;
+    return instance;
+}
+
+std::map<std::string, std::shared_ptr<void>> &pools() {
+    static std::map<std::string, std::shared_ptr<void>> instance;
+    return instance;
+}
+
+template <class T, class F>
+std::vector<T> const &pooled(std::string const &key, F generate) {
+    std::lock_guard<std::mutex> guard(pools_mutex());
+    auto &slot = pools()[key];
+    if (!slot)
+        slot = std::make_shared<std::vector<T>>(generate());
+    return *static_cast<std::vector<T> *>(slot.get());
+}
+
+// integers are formatted exactly, through a double they'd collide above 2^53
+void append_key(std::string &key, int64_t x) {
+    key += '/' + std::to_string(x);
+}
+
+void append_key(std::string &key, uint64_t x) {
+    key += '/' + std::to_string(x);
+}
+
+void append_key(std::string &key, double x) {
+    char buf[32];
+    snprintf(buf, sizeof buf, "/%.17g", x);
+    key += buf;
+}
+
+template <class... Params>
+std::string make_key(const char *kind, size_t n, uint64_t seed, Params... params) {
+    std::string key = kind;
+    append_key(key, (uint64_t)n);
+    append_key(key, seed);
+    int expand[] = {0, (append_key(key, params), 0)...};
+    (void)expand;
+    return key;
+}
+
+// rejection-inversion sampling after Hormann and Derflinger, constant time
+// per sample whatever the number of items
+struct ZipfSampler {
+    double exponent;
+    int64_t nitems;
+    double h_integral_x1;
+    double h_integral_n;
+    double s;
+
+    static double helper1(double x) {
+        return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+    }
+
+    static double helper2(double x) {
+        return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x));
+    }
+
+    double h(double x) const {
+        return std::exp(-exponent * std::log(x));
+    }
+
+    double h_integral(double x) const {
+        double log_x = std::log(x);
+        return helper2((1 - exponent) * log_x) * log_x;
+    }
+
+    double h_integral_inverse(double x) const {
+        double t = std::max(x * (1 - exponent), -1.0);
+        return std::exp(helper1(t) * x);
+    }
+
+    ZipfSampler(int64_t nitems_, double exponent_) : exponent(exponent_), nitems(nitems_) {
+        h_integral_x1 = h_integral(1.5) - 1;
+        h_integral_n = h_integral(nitems + 0.5);
+        s = 2 - h_integral_inverse(h_integral(2.5) - h(2));
+    }
+
+    int64_t operator()(uint64_t seed, uint64_t i) const {
+        uint64_t key = mix(seed, i);
+        for (uint64_t attempt = 0;; attempt++) {
+            double u = h_integral_n + unit(mix(key, attempt)) * (h_integral_x1 - h_integral_n);
+            double x = h_integral_inverse(u);
+            int64_t k = std::min(std::max((int64_t)(x + 0.5), (int64_t)1), nitems);
+            if (k - x <= s || u >= h_integral(k + 0.5) - h(k))
+                return k;
+        }
+    }
+};
+
+std::vector<int64_t> generate_sorted(size_t n, uint64_t seed) {
+    std::vector<int64_t> ret(n);
+    seed = stream_seed(seed, kSorted);
+    parallel_for(n, [&] (size_t begin, size_t end) {
+        int64_t *HERMES_RESTRICT p = ret.data();
+        for (size_t i = begin; i < end; i++)
+            p[i] = (int64_t)i * 4 + (int64_t)(mix(seed, i) & 3);
+    });
+    return ret;
+}
+
+}
+
+std::vector<int64_t> const &uniform(size_t n, int64_t lo, int64_t hi, uint64_t seed) {
+    return pooled<int64_t>(make_key("uniform", n, seed, lo, hi), [=] {
+        std::vector<int64_t> ret(n);
+        uint64_t range = (uint64_t)hi - (uint64_t)lo + 1;
+        uint64_t s = stream_seed(seed, kUniform);
+        parallel_for(n, [&] (size_t begin, size_t end) {
+            int64_t *HERMES_RESTRICT p = ret.data();
+            for (size_t i = begin; i < end; i++)
+                p[i] = lo + (int64_t)bounded(mix(s, i), range);
+        });
+        return ret;
+    });
+}
+
+std::vector<int64_t> const &normal(size_t n, double mean, double stddev, uint64_t seed) {
+    return pooled<int64_t>(make_key("normal", n, seed, mean, stddev), [=] {
+        std::vector<int64_t> ret(n);
+        uint64_t s = stream_seed(seed, kNormal);
+        parallel_for(n, [&] (size_t begin, size_t end) {
+            int64_t *HERMES_RESTRICT p = ret.data();
+            for (size_t i = begin; i < end; i++) {
+                // Box-Muller, from two draws of the element's own counters
+                double u1 = unit(mix(s, 2 * i));
+                double u2 = unit(mix(s, 2 * i + 1));
+                double z = std::sqrt(-2 * std::log(u1)) * std::cos(2 * M_PI * u2);
+                p[i] = (int64_t)std::llround(mean + stddev * z);
+            }
+        });
+        return ret;
+    });
+}
+
+std::vector<int64_t> const &zipf(size_t n, int64_t nitems, double s, uint64_t seed) {
+    return pooled<int64_t>(make_key("zipf", n, seed, nitems, s), [=] {
+        std::vector<int64_t> ret(n);
+        ZipfSampler sampler(std::max<int64_t>(nitems, 1), s);
+        uint64_t ss = stream_seed(seed, kZipf);
+        parallel_for(n, [&] (size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                ret[i] = sampler(ss, i);
+        });
+        return ret;
+    });
+}
+
+std::vector<int64_t> const &sorted(size_t n, uint64_t seed) {
+    return pooled<int64_t>(make_key("sorted", n, seed), [=] {
+        return generate_sorted(n, seed);
+    });
+}
+
+std::vector<int64_t> const &nearly_sorted(size_t n, double swap_fraction, uint64_t seed) {
+    return pooled<int64_t>(make_key("nearly_sorted", n, seed, swap_fraction), [=] {
+        std::vector<int64_t> ret = generate_sorted(n, seed);
+        if (n < 2)
+            return ret;
+        uint64_t s = stream_seed(seed, kNearlySorted);
+        size_t nswaps = (size_t)(swap_fraction * n);
+        for (size_t k = 0; k < nswaps; k++) {
+            size_t i = bounded(mix(s, 2 * k), n);
+            size_t j = std::min(n - 1, i + 1 + bounded(mix(s, 2 * k + 1), 16));
+            std::swap(ret[i], ret[j]);
+        }
+        return ret;
+    });
+}
+
+std::vector<int64_t> const &permutation(size_t n, uint64_t seed) {
+    return pooled<int64_t>(make_key("permutation", n, seed), [=] {
+        std::vector<int64_t> ret(n);
+        parallel_for(n, [&] (size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                ret[i] = (int64_t)i;
+        });
+        // Fisher-Yates is inherently serial, but still draws from the
+        // counter based generator so the result is independent of threads
+        uint64_t s = stream_seed(seed, kPermutation);
+        for (size_t i = n; i > 1; i--)
+            std::swap(ret[i - 1], ret[bounded(mix(s, i), i)]);
+        return ret;
+    });
+}
+
+std::vector<int64_t> const &pointer_chase(size_t n, uint64_t seed) {
+    return pooled<int64_t>(make_key("pointer_chase", n, seed), [=] {
+        // Sattolo's variant of Fisher-Yates only yields single cycles, so
+        // following next[] visits every element before coming back
+        std::vector<int64_t> order(n);
+        for (size_t i = 0; i < n; i++)
+            order[i] = (int64_t)i;
+        uint64_t s = stream_seed(seed, kPointerChase);
+        for (size_t i = n; i > 1; i--)
+            std::swap(order[i - 1], order[bounded(mix(s, i), i - 1)]);
+        std::vector<int64_t> next(n);
+        parallel_for(n, [&] (size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                next[order[i]] = order[(i + 1) % n];
+        });
+        return next;
+    });
+}
+
+std::vector<std::string> const &strings(size_t n, size_t min_len, size_t max_len, uint64_t seed) {
+    return pooled<std::string>(make_key("strings", n, seed, min_len, max_len), [=] {
+        static const char kAlphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+        std::vector<std::string> ret(n);
+        uint64_t s = stream_seed(seed, kStrings);
+        size_t hi = std::max(min_len, max_len);
+        parallel_for(n, [&] (size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                uint64_t key = mix(s, i);
+                size_t len = min_len + bounded(key, hi - min_len + 1);
+                std::string &str = ret[i];
+                str.resize(len);
+                for (size_t j = 0; j < len; j++)
+                    str[j] = kAlphabet[bounded(mix(key, j), sizeof kAlphabet - 1)];
+            }
+        });
+        return ret;
+    });
+}
+
+void clear_pools() {
+    std::lock_guard<std::mutex> guard(pools_mutex());
+    pools().clear();
+}
+
+}
+
+}
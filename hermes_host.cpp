@@ -0,0 +1,175 @@
+#include "hermes.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#if __linux__
+#include <sched.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#endif
+
+namespace hermes {
+
+namespace {
+
+std::string read_line(std::string const &path) {
+    std::string line;
+    FILE *fp = fopen(path.c_str(), "r");
+    if (fp) {
+        char buf[512];
+        if (fgets(buf, sizeof buf, fp))
+            line = std::string(buf, strcspn(buf, "\n"));
+        fclose(fp);
+    }
+    return line;
+}
+
+std::string cpuinfo_field(const char *key) {
+    std::string value;
+    FILE *fp = fopen("/proc/cpuinfo", "r");
+    if (fp) {
+        char line[512];
+        size_t len = strlen(key);
+        while (fgets(line, sizeof line, fp)) {
+            if (!strncmp(line, key, len)) {
+                const char *colon = strchr(line, ':');
+                if (colon) {
+                    colon += 1 + (colon[1] == ' ');
+                    value = std::string(colon, strcspn(colon, "\n"));
+                }
+                break;
+            }
+        }
+        fclose(fp);
+    }
+    return value;
+}
+
+// ticks of now() per nanosecond, against the steady clock over 20ms
+double measure_tick_rate() {
+    auto c0 = std::chrono::steady_clock::now();
+    int64_t t0 = now();
+    auto c1 = c0;
+    while (c1 - c0 < std::chrono::milliseconds(20))
+        c1 = std::chrono::steady_clock::now();
+    int64_t t1 = now();
+    return (t1 - t0) / (double)std::chrono::duration_cast<std::chrono::nanoseconds>(c1 - c0).count();
+}
+
+HostInfo capture() {
+    HostInfo host;
+    host.tick_ghz = measure_tick_rate();
+#if __linux__
+    host.cpu = cpuinfo_field("model name");
+    if (host.cpu.empty())
+        host.cpu = cpuinfo_field("CPU part");
+    host.microcode = cpuinfo_field("microcode");
+    unsigned int cpu = 0;
+    getcpu(&cpu, nullptr);
+    std::string sys = "/sys/devices/system/cpu/";
+    host.governor = read_line(sys + "cpu" + std::to_string(cpu) + "/cpufreq/scaling_governor");
+    std::string no_turbo = read_line(sys + "intel_pstate/no_turbo");
+    std::string boost = read_line(sys + "cpufreq/boost");
+    if (!no_turbo.empty())
+        host.turbo = no_turbo == "0" ? "on" : "off";
+    else if (!boost.empty())
+        host.turbo = boost == "1" ? "on" : "off";
+    std::string smt = read_line(sys + "smt/active");
+    if (!smt.empty())
+        host.smt = smt == "1" ? "on" : "off";
+    host.cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 0;; i++) {
+        std::string index = sys + "cpu" + std::to_string(cpu) + "/cache/index" + std::to_string(i) + "/";
+        std::string level = read_line(index + "level");
+        if (level.empty())
+            break;
+        std::string type = read_line(index + "type");
+        if (!host.caches.empty())
+            host.caches += ' ';
+        host.caches += 'L' + level;
+        if (type == "Data")
+            host.caches += 'd';
+        else if (type == "Instruction")
+            host.caches += 'i';
+        host.caches += '=' + read_line(index + "size");
+    }
+    host.numa = read_line("/sys/devices/system/node/online");
+    struct utsname uts;
+    if (!uname(&uts)) {
+        host.kernel = uts.release;
+        host.kernel += ' ';
+        host.kernel += uts.machine;
+    }
+    std::string thp = read_line("/sys/kernel/mm/transparent_hugepage/enabled");
+    size_t open = thp.find('['), close = thp.find(']');
+    if (open != std::string::npos && close > open)
+        host.thp = thp.substr(open + 1, close - open - 1);
+    host.isolcpus = read_line(sys + "isolated");
+#endif
+#if __GNUC__ && !__clang__
+    host.compiler = "gcc " __VERSION__;
+#elif __VERSION__
+    host.compiler = __VERSION__;
+#elif _MSC_VER
+    host.compiler = "MSVC " + std::to_string(_MSC_VER);
+#endif
+#ifdef HERMES_CXX_FLAGS
+    host.flags = HERMES_CXX_FLAGS;
+#endif
+    return host;
+}
+
+}
+
+std::vector<std::pair<std::string, std::string>> HostInfo::fields() const {
+    char tick[32];
+    snprintf(tick, sizeof tick, "%.3f", tick_ghz);
+    return {
+        {"cpu", cpu},
+        {"microcode", microcode},
+        {"tick_ghz", tick},
+        {"governor", governor},
+        {"turbo", turbo},
+        {"smt", smt},
+        {"cpus", std::to_string(cpus)},
+        {"caches", caches},
+        {"numa", numa},
+        {"kernel", kernel},
+        {"thp", thp},
+        {"compiler", compiler},
+        {"flags", flags},
+        {"isolcpus", isolcpus},
+    };
+}
+
+bool HostInfo::decisive(std::string const &field) {
+    // microcode, kernel and the measured tick rate are recorded but may
+    // drift on the same machine without invalidating its history
+    return field != "microcode" && field != "kernel" && field != "tick_ghz" && field != "isolcpus";
+}
+
+std::string HostInfo::fingerprint() const {
+    uint64_t h = 14695981039346656037ull;
+    for (auto const &f: fields()) {
+        if (!decisive(f.first))
+            continue;
+        for (char c: f.first + '=' + f.second + '\n') {
+            h ^= (unsigned char)c;
+            h *= 1099511628211ull;
+        }
+    }
+    char buf[17];
+    snprintf(buf, sizeof buf, "%016llx", (unsigned long long)h);
+    return buf;
+}
+
+HostInfo const &host_info() {
+    static const HostInfo host = capture();
+    return host;
+}
+
+}
@@ -0,0 +1,319 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Record {
+    long long time;
+    std::string commit;
+    std::string host;
+    std::string name;
+    double med;
+    double avg;
+    double stddev;
+    double min;
+    double max;
+    long long count;
+};
+
+// host id to the conditions recorded for it by the history reporter
+std::map<std::string, std::vector<std::pair<std::string, std::string>>> hosts;
+
+std::vector<Record> load(const char *path) {
+    std::vector<Record> records;
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "cannot open %s\n", path);
+        exit(1);
+    }
+    char line[2048];
+    while (fgets(line, sizeof line, fp)) {
+        if (!strncmp(line, "# host ", 7)) {
+            line[strcspn(line, "\n")] = 0;
+            char *field = strtok(line + 7, "\t");
+            auto &fields = hosts[field];
+            fields.clear();
+            while ((field = strtok(nullptr, "\t"))) {
+                char *eq = strchr(field, '=');
+                if (eq)
+                    fields.emplace_back(std::string(field, eq), eq + 1);
+            }
+        }
+        if (line[0] == '#')
+            continue;
+        char commit[256], host[64], name[1024];
+        Record r;
+        if (sscanf(line, "%lld\t%255[^\t]\t%63[^\t]\t%1023[^\t]\t%lf\t%lf\t%lf\t%lf\t%lf\t%lld",
+                   &r.time, commit, host, name, &r.med, &r.avg, &r.stddev, &r.min, &r.max, &r.count) != 10)
+            continue;
+        r.commit = commit;
+        r.host = host;
+        r.name = name;
+        records.push_back(std::move(r));
+    }
+    fclose(fp);
+    return records;
+}
+
+double median(std::vector<double> v) {
+    if (v.empty())
+        return 0;
+    size_t n = v.size();
+    std::nth_element(v.begin(), v.begin() + n / 2, v.end());
+    double hi = v[n / 2];
+    if (n % 2)
+        return hi;
+    std::nth_element(v.begin(), v.begin() + (n - 1) / 2, v.end());
+    return (v[(n - 1) / 2] + hi) / 2;
+}
+
+std::string format_time(long long t) {
+    time_t tt = (time_t)t;
+    char buf[32];
+    strftime(buf, sizeof buf, "%Y-%m-%d %H:%M", localtime(&tt));
+    return buf;
+}
+
+struct Point {
+    long long time;
+    std::string commit;
+    double med;
+    int runs;
+};
+
+// the history of one benchmark on one host, one point per commit in the
+// order they were first measured, the median over repeated runs
+std::vector<Point> series(std::vector<Record> const &records, std::string const &name, std::string &host) {
+    if (host.empty()) {
+        for (auto const &r: records) {
+            if (r.name == name)
+                host = r.host;
+        }
+    }
+    std::map<std::string, size_t> index;
+    std::vector<Point> points;
+    std::vector<std::vector<double>> values;
+    std::map<std::string, size_t> skipped;
+    for (auto const &r: records) {
+        if (r.name != name)
+            continue;
+        if (r.host != host) {
+            ++skipped[r.host];
+            continue;
+        }
+        auto it = index.find(r.commit);
+        if (it == index.end()) {
+            it = index.emplace(r.commit, points.size()).first;
+            points.push_back(Point{r.time, r.commit, 0, 0});
+            values.emplace_back();
+        }
+        values[it->second].push_back(r.med);
+        ++points[it->second].runs;
+    }
+    for (size_t i = 0; i < points.size(); i++)
+        points[i].med = median(values[i]);
+    // results from hosts with other decisive conditions are never compared
+    auto const &mine = hosts[host];
+    for (auto const &kv: skipped) {
+        fprintf(stderr, "ignoring %zu runs of %s from incompatible host %s, pass --host=ID to pick it\n",
+                kv.second, name.c_str(), kv.first.c_str());
+        for (auto const &theirs: hosts[kv.first]) {
+            for (auto const &f: mine) {
+                if (f.first == theirs.first && f.second != theirs.second)
+                    fprintf(stderr, "    %s: %s vs %s\n", f.first.c_str(), f.second.c_str(), theirs.second.c_str());
+            }
+        }
+    }
+    return points;
+}
+
+struct Fit {
+    double slope;
+    double intercept;
+    double sse;
+};
+
+Fit fit_line(std::vector<double> const &x, std::vector<double> const &y, size_t a, size_t b) {
+    double n = b - a, sx = 0, sy = 0;
+    for (size_t i = a; i < b; i++) {
+        sx += x[i];
+        sy += y[i];
+    }
+    double mx = sx / n, my = sy / n, sxx = 0, sxy = 0;
+    for (size_t i = a; i < b; i++) {
+        sxx += (x[i] - mx) * (x[i] - mx);
+        sxy += (x[i] - mx) * (y[i] - my);
+    }
+    Fit f;
+    f.slope = sxx > 0 ? sxy / sxx : 0;
+    f.intercept = my - f.slope * mx;
+    f.sse = 0;
+    for (size_t i = a; i < b; i++) {
+        double e = y[i] - (f.intercept + f.slope * x[i]);
+        f.sse += e * e;
+    }
+    return f;
+}
+
+const size_t kMinSegment = 3;
+
+// binary segmentation with piecewise linear segments, so both sudden steps
+// and a change of slope (a slow creep starting) are found; a split is kept
+// when it explains more than the BIC penalty for its three extra parameters
+void segment(std::vector<double> const &x, std::vector<double> const &y, size_t a, size_t b,
+             double penalty, std::vector<size_t> &splits) {
+    if (b - a < 2 * kMinSegment)
+        return;
+    double whole = fit_line(x, y, a, b).sse;
+    double best_gain = 0;
+    size_t best = 0;
+    for (size_t k = a + kMinSegment; k + kMinSegment <= b; k++) {
+        double gain = whole - fit_line(x, y, a, k).sse - fit_line(x, y, k, b).sse;
+        if (gain > best_gain) {
+            best_gain = gain;
+            best = k;
+        }
+    }
+    if (!best || best_gain <= penalty)
+        return;
+    segment(x, y, a, best, penalty, splits);
+    splits.push_back(best);
+    segment(x, y, best, b, penalty, splits);
+}
+
+int cmd_list(std::vector<Record> const &records) {
+    std::map<std::string, std::pair<size_t, long long>> names;
+    std::set<std::string> hosts;
+    for (auto const &r: records) {
+        auto &n = names[r.name];
+        ++n.first;
+        n.second = std::max(n.second, r.time);
+        hosts.insert(r.host);
+    }
+    printf("%32s %6s %17s\n", "name", "runs", "last");
+    for (auto const &kv: names)
+        printf("%32s %6zu %17s\n", kv.first.c_str(), kv.second.first, format_time(kv.second.second).c_str());
+    printf("\n%zu hosts:", hosts.size());
+    for (auto const &h: hosts)
+        printf(" %s", h.c_str());
+    printf("\n");
+    return 0;
+}
+
+int cmd_trend(std::vector<Record> const &records, std::string const &name, std::string host) {
+    auto points = series(records, name, host);
+    if (points.empty()) {
+        fprintf(stderr, "no history for %s\n", name.c_str());
+        return 1;
+    }
+    double lo = INFINITY, hi = -INFINITY;
+    for (auto const &p: points) {
+        lo = std::min(lo, p.med);
+        hi = std::max(hi, p.med);
+    }
+    printf("%s on host %s\n\n", name.c_str(), host.c_str());
+    printf("%17s %18s %11s %8s %4s\n", "time", "commit", "med", "change", "runs");
+    for (auto const &p: points) {
+        double change = (p.med / points.front().med - 1) * 100;
+        int width = hi > lo ? (int)std::lround((p.med - lo) / (hi - lo) * 30) : 0;
+        printf("%17s %18s %11.4g %+7.2lf%% %4d |%.*s\n", format_time(p.time).c_str(), p.commit.c_str(),
+               p.med, change, p.runs, width, "##############################");
+    }
+    return 0;
+}
+
+int cmd_changepoints(std::vector<Record> const &records, std::string const &name, std::string host) {
+    auto points = series(records, name, host);
+    if (points.size() < 2 * kMinSegment) {
+        fprintf(stderr, "need at least %zu commits of history for %s, have %zu\n",
+                2 * kMinSegment, name.c_str(), points.size());
+        return 1;
+    }
+    // relative changes are what matters, so fit log cost over weeks
+    std::vector<double> x, y;
+    for (auto const &p: points) {
+        x.push_back((p.time - points.front().time) / 604800.0);
+        y.push_back(std::log(std::max(p.med, 1e-300)));
+    }
+    // robust noise level from the first differences, which a trend barely moves
+    std::vector<double> diffs;
+    for (size_t i = 1; i < y.size(); i++)
+        diffs.push_back(y[i] - y[i - 1]);
+    double center = median(diffs);
+    for (auto &d: diffs)
+        d = std::abs(d - center);
+    double sigma = std::max(1.4826 * median(diffs) / std::sqrt(2.0), 1e-6);
+    double penalty = 3 * std::log((double)y.size()) * sigma * sigma;
+
+    std::vector<size_t> splits;
+    segment(x, y, 0, y.size(), penalty, splits);
+
+    printf("%s on host %s, %zu commits, noise %.2lf%%\n\n", name.c_str(), host.c_str(), points.size(), sigma * 100);
+    if (splits.empty()) {
+        Fit f = fit_line(x, y, 0, y.size());
+        printf("no changepoint, overall trend %+.2lf%%/week\n", f.slope * 100);
+        return 0;
+    }
+    std::vector<size_t> bounds{0};
+    bounds.insert(bounds.end(), splits.begin(), splits.end());
+    bounds.push_back(y.size());
+    for (size_t s = 1; s + 1 < bounds.size(); s++) {
+        size_t k = bounds[s];
+        Fit before = fit_line(x, y, bounds[s - 1], k);
+        Fit after = fit_line(x, y, k, bounds[s + 1]);
+        double jump = std::exp((after.intercept + after.slope * x[k]) - (before.intercept + before.slope * x[k])) - 1;
+        printf("changepoint at %s (%s)\n", points[k].commit.c_str(), format_time(points[k].time).c_str());
+        printf("    step %+.2lf%%, trend %+.2lf%%/week -> %+.2lf%%/week\n",
+               jump * 100, before.slope * 100, after.slope * 100);
+    }
+    return 0;
+}
+
+int usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [--file=PATH] [--host=ID] list\n"
+            "       %s [--file=PATH] [--host=ID] trend NAME\n"
+            "       %s [--file=PATH] [--host=ID] changepoints NAME\n",
+            argv0, argv0, argv0);
+    return 1;
+}
+
+}
+
+int main(int argc, char **argv) {
+    const char *path = ".hermes_history";
+    std::string host;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        if (!strncmp(argv[i], "--file=", 7))
+            path = argv[i] + 7;
+        else if (!strncmp(argv[i], "--host=", 7))
+            host = argv[i] + 7;
+        else if (argv[i][0] == '-')
+            return usage(argv[0]);
+        else
+            args.push_back(argv[i]);
+    }
+    if (args.empty())
+        return usage(argv[0]);
+
+    auto records = load(path);
+    std::stable_sort(records.begin(), records.end(), [] (Record const &a, Record const &b) {
+        return a.time < b.time;
+    });
+    if (args[0] == "list" && args.size() == 1)
+        return cmd_list(records);
+    if (args[0] == "trend" && args.size() == 2)
+        return cmd_trend(records, args[1], host);
+    if (args[0] == "changepoints" && args.size() == 2)
+        return cmd_changepoints(records, args[1], host);
+    return usage(argv[0]);
+}
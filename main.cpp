@@ -4,19 +4,41 @@
 
 BENCHMARK(BM_memcpy, {hermes::log_range(1 << 10, 1 << 26, 2)}) {
     size_t n = h.arg(0);
-    char *dst = (char *)malloc(n);
-    char *src = (char *)malloc(n);
-    memset(dst, 0, n);
-    memset(src, 0, n);
+    char *dst = (char *)hermes::alloc(n);
+    char *src = (char *)hermes::alloc(n);
     for (auto _: h) {
         memcpy(dst, src, n);
         hermes::do_not_optimize(dst);
     }
     h.set_items_processed(h.iterations() * n);
-    free(src);
-    free(dst);
+    hermes::dealloc(src);
+    hermes::dealloc(dst);
 }
 
+/* BENCHMARK(BM_memcpy_placement, {hermes::log_range(1 << 18, 1 << 28, 4), */
+/*                                 hermes::page_size_range(), hermes::node_distance_range()}) { */
+/*     size_t n = h.arg(0); */
+/*     hermes::AllocOptions opts; */
+/*     opts.page_size = h.arg(1); */
+/*     opts.placement = hermes::NumaPlacement::Distance; */
+/*     opts.node_distance = h.arg(2); */
+/*     char *dst = (char *)hermes::alloc(n, opts); */
+/*     char *src = (char *)hermes::alloc(n, opts); */
+/*     if (!dst || !src) { */
+/*         hermes::dealloc(src); */
+/*         hermes::dealloc(dst); */
+/*         h.skip(); */
+/*         return; */
+/*     } */
+/*     for (auto _: h) { */
+/*         memcpy(dst, src, n); */
+/*         hermes::do_not_optimize(dst); */
+/*     } */
+/*     h.set_items_processed(h.iterations() * n); */
+/*     hermes::dealloc(src); */
+/*     hermes::dealloc(dst); */
+/* } */
+
 /* BENCHMARK(BM_memcpy_page_align, {hermes::log_range(1 << 18, 1 << 28, 4)}) { */
 /*     size_t n = h.arg(0); */
 /*     char *dst = (char *)aligned_alloc(4096, n); */
@@ -47,6 +69,15 @@ BENCHMARK(BM_memcpy, {hermes::log_range(1 << 10, 1 << 26, 2)}) {
 /*     free(dst); */
 /* } */
 
+/* BENCHMARK(BM_pointer_chase, {hermes::log_range(1 << 10, 1 << 24, 4)}) { */
+/*     auto const &next = hermes::data::pointer_chase(h.arg(0)); */
+/*     int64_t i = 0; */
+/*     for (auto _: h) { */
+/*         i = next[i]; */
+/*         hermes::do_not_optimize(i); */
+/*     } */
+/* } */
+
 /* BENCHMARK(BM_read) { */
 /*     uintptr_t buf; */
 /*     buf = (uintptr_t)&buf; */
@@ -81,11 +112,15 @@ BENCHMARK(BM_memcpy, {hermes::log_range(1 << 10, 1 << 26, 2)}) {
 /*     h.set_items_processed(h.iterations() * 8); */
 /* } */
 
-int main() {
+int main(int argc, char **argv) {
+    hermes::Options options = hermes::parse_args(argc, argv);
     std::unique_ptr<hermes::Reporter> rep(hermes::makeMultipleReporter({
             hermes::makeConsoleReporter(),
             hermes::makeSVGReporter("bench.svg"),
+            hermes::makeSweepReporter("sweep.svg"),
+            hermes::makeHistoryReporter(".hermes_history"),
+            hermes::makeJSONReporter("bench.json"),
     }));
-    rep->run_all();
+    rep->run_all(options);
     return 0;
 }